@@ -1,7 +1,605 @@
 #pragma once
 
+// SSE2 is used to scan strings for characters that need escaping;
+// other targets (including Xbox 360) fall back to 8-byte SWAR scanning
+#ifndef TINYJSON_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TINYJSON_SSE2 1
+#else
+#define TINYJSON_SSE2 0
+#endif
+#endif
+
+#if TINYJSON_SSE2
+#include <emmintrin.h>
+#endif
+
+// Platform APIs for durable saves (fsync + rename), memory-mapped snapshots
+// and the background writer.
+// Define TINYJSON_NO_THREADS to leave out json_async_writer, dump_parallel()
+// and their threads.
+#if defined(_XBOX)
+#include <xtl.h>
+#include <io.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <time.h>
+#ifndef TINYJSON_NO_THREADS
+#include <pthread.h>
+#endif
+#endif
+
+namespace tinyjson {
+    namespace detail {
+        // Flush stdio and OS buffers of an open file to the device
+        inline bool sync_file(FILE* file) {
+            if (fflush(file) != 0) return false;
+#if defined(_WIN32) || defined(_XBOX)
+            return _commit(_fileno(file)) == 0;
+#else
+            return fsync(fileno(file)) == 0;
+#endif
+        }
+
+        // Replace target with source. Atomic on POSIX and Windows; on Xbox 360
+        // the old file is removed first, but only after source is fully on disk.
+        inline bool replace_file(const std::string& source, const std::string& target) {
+#if defined(_XBOX)
+            DeleteFileA(target.c_str());
+            return MoveFileA(source.c_str(), target.c_str()) != 0;
+#elif defined(_WIN32)
+            return MoveFileExA(source.c_str(), target.c_str(),
+                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+            if (rename(source.c_str(), target.c_str()) != 0) return false;
+
+            // Persist the directory entry as well
+            std::string dir = ".";
+            size_t slash = target.find_last_of('/');
+            if (slash != std::string::npos) dir = slash == 0 ? "/" : target.substr(0, slash);
+            int fd = open(dir.c_str(), O_RDONLY);
+            if (fd >= 0) {
+                fsync(fd);
+                close(fd);
+            }
+            return true;
+#endif
+        }
+
+        inline long atomic_increment(volatile long* value);
+
+        // Create "<filepath>.<pid>.<n>.tmp" for writing, next to filepath so
+        // the rename stays on one file system. The process id and a counter
+        // give every save its own name, so concurrent saves of one target
+        // don't write into each other's file; the exclusive create steps over
+        // names a crashed save left behind.
+        inline FILE* create_temp_file(const std::string& filepath, std::string& temp) {
+            static volatile long counter = 0;
+#if defined(_XBOX)
+            unsigned long process = 0;   // one title runs at a time
+#elif defined(_WIN32)
+            unsigned long process = GetCurrentProcessId();
+#else
+            unsigned long process = static_cast<unsigned long>(getpid());
+#endif
+            for (int attempt = 0; attempt < 100; ++attempt) {
+                char suffix[64];
+                sprintf(suffix, ".%lu.%ld.tmp", process, atomic_increment(&counter));
+                temp = filepath + suffix;
+#if defined(_WIN32) || defined(_XBOX)
+                int fd = _open(temp.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+                int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+#endif
+                if (fd < 0) {
+                    if (errno == EEXIST) continue;
+                    return nullptr;
+                }
+#if defined(_WIN32) || defined(_XBOX)
+                FILE* file = _fdopen(fd, "wb");
+                if (!file) _close(fd);
+#else
+                FILE* file = fdopen(fd, "wb");
+                if (!file) close(fd);
+#endif
+                if (!file) remove(temp.c_str());
+                return file;
+            }
+            return nullptr;
+        }
+
+        // Write data to a temporary file (create_temp_file()), sync it and
+        // rename it over filepath, so a crash leaves either the old or the
+        // new file, never a torn one
+        inline bool write_file_atomic(const std::string& filepath, const char* data, size_t size, std::string& error_msg) {
+            std::string temp;
+            FILE* file = create_temp_file(filepath, temp);
+            if (!file) {
+                error_msg = "Failed to open file for writing: " + temp;
+                return false;
+            }
+
+            size_t written = fwrite(data, 1, size, file);
+            bool synced = sync_file(file);
+            bool closed = fclose(file) == 0;
+
+            if (written != size) {
+                error_msg = "Failed to write complete data to " + temp;
+            }
+            else if (!synced || !closed) {
+                error_msg = "Failed to flush file to disk: " + temp;
+            }
+            else if (!replace_file(temp, filepath)) {
+                error_msg = "Failed to replace " + filepath;
+            }
+            else {
+                return true;
+            }
+
+            remove(temp.c_str());
+            return false;
+        }
+
+        // One piece of scatter-gather output
+        struct segment {
+            const char* data;
+            size_t length;
+        };
+
+        // Write every segment to a file descriptor, in order. POSIX hands them
+        // to writev() in batches; elsewhere each one is a separate _write().
+        inline bool write_segments(int fd, const segment* segments, size_t count) {
+#if defined(_WIN32) || defined(_XBOX)
+            for (size_t i = 0; i < count; ++i) {
+                const char* data = segments[i].data;
+                size_t left = segments[i].length;
+                while (left > 0) {
+                    unsigned int step = left > 0x40000000 ? 0x40000000u : static_cast<unsigned int>(left);
+                    int written = _write(fd, data, step);
+                    if (written <= 0) return false;
+                    data += written;
+                    left -= static_cast<size_t>(written);
+                }
+            }
+            return true;
+#else
+#ifdef IOV_MAX
+            const size_t batch_max = IOV_MAX;
+#else
+            const size_t batch_max = 1024;
+#endif
+            iovec batch[64];
+            const size_t limit = batch_max < 64 ? batch_max : 64;
+            size_t next = 0;
+            size_t offset = 0;   // bytes of segments[next] already written
+            while (next < count) {
+                size_t batch_count = 0;
+                for (size_t i = next; i < count && batch_count < limit; ++i) {
+                    batch[batch_count].iov_base = const_cast<char*>(segments[i].data) + (i == next ? offset : 0);
+                    batch[batch_count].iov_len = segments[i].length - (i == next ? offset : 0);
+                    ++batch_count;
+                }
+
+                ssize_t written = writev(fd, batch, static_cast<int>(batch_count));
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+
+                // Skip what went out; a short write resumes mid-segment
+                size_t done = static_cast<size_t>(written);
+                while (next < count && done >= segments[next].length - offset) {
+                    done -= segments[next].length - offset;
+                    offset = 0;
+                    ++next;
+                }
+                offset += done;
+            }
+            return true;
+#endif
+        }
+
+        // Open filepath for writing (created or truncated); -1 on failure
+        inline int open_for_writing(const std::string& filepath) {
+#if defined(_WIN32) || defined(_XBOX)
+            return _open(filepath.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            return open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+#endif
+        }
+
+        inline bool close_file(int fd) {
+#if defined(_WIN32) || defined(_XBOX)
+            return _close(fd) == 0;
+#else
+            return close(fd) == 0;
+#endif
+        }
+
+        // Read-only view of a whole file: mmap() on POSIX, a file mapping on
+        // Windows, and a plain read into memory on Xbox 360
+        class mapped_file {
+        public:
+            mapped_file() : m_data(nullptr), m_size(0) {
+#if defined(_WIN32) && !defined(_XBOX)
+                m_file = INVALID_HANDLE_VALUE;
+                m_mapping = nullptr;
+#endif
+            }
+
+            ~mapped_file() { close(); }
+
+            bool open(const std::string& filepath) {
+                close();
+#if defined(_XBOX)
+                FILE* file = fopen(filepath.c_str(), "rb");
+                if (!file) return false;
+                fseek(file, 0, SEEK_END);
+                long size = ftell(file);
+                fseek(file, 0, SEEK_SET);
+                if (size <= 0) {
+                    fclose(file);
+                    return false;
+                }
+                char* buffer = new char[size];
+                size_t read = fread(buffer, 1, static_cast<size_t>(size), file);
+                fclose(file);
+                if (read != static_cast<size_t>(size)) {
+                    delete[] buffer;
+                    return false;
+                }
+                m_data = buffer;
+                m_size = static_cast<size_t>(size);
+                return true;
+#elif defined(_WIN32)
+                m_file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (m_file == INVALID_HANDLE_VALUE) return false;
+                LARGE_INTEGER size;
+                if (!GetFileSizeEx(m_file, &size) || size.QuadPart <= 0) {
+                    close();
+                    return false;
+                }
+                m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (!m_mapping) {
+                    close();
+                    return false;
+                }
+                m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+                if (!m_data) {
+                    close();
+                    return false;
+                }
+                m_size = static_cast<size_t>(size.QuadPart);
+                return true;
+#else
+                int fd = ::open(filepath.c_str(), O_RDONLY);
+                if (fd < 0) return false;
+                struct stat info;
+                if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+                    ::close(fd);
+                    return false;
+                }
+                void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (data == MAP_FAILED) return false;
+                m_data = static_cast<const char*>(data);
+                m_size = static_cast<size_t>(info.st_size);
+                return true;
+#endif
+            }
+
+            void close() {
+#if defined(_XBOX)
+                delete[] m_data;
+#elif defined(_WIN32)
+                if (m_data) UnmapViewOfFile(m_data);
+                if (m_mapping) CloseHandle(m_mapping);
+                if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+                m_mapping = nullptr;
+                m_file = INVALID_HANDLE_VALUE;
+#else
+                if (m_data) munmap(const_cast<char*>(m_data), m_size);
+#endif
+                m_data = nullptr;
+                m_size = 0;
+            }
+
+            const char* data() const { return m_data; }
+            size_t size() const { return m_size; }
+
+        private:
+            const char* m_data;
+            size_t m_size;
+#if defined(_WIN32) && !defined(_XBOX)
+            HANDLE m_file;
+            HANDLE m_mapping;
+#endif
+
+            mapped_file(const mapped_file&);
+            mapped_file& operator=(const mapped_file&);
+        };
+
+        // Binary snapshot layout (native byte order, 32-bit offsets):
+        //   header
+        //   nodes    16 bytes each in breadth-first order, so the children of
+        //            a container are consecutive: type byte, then
+        //            string: offset, length | array: count, first child |
+        //            object: count, first child, key table offset |
+        //            number: 8-byte value at +8 | boolean: value
+        //   keys     per object: (offset, length) of every member name in
+        //            insertion order, then member positions sorted by name
+        //   strings  bytes of every string, each followed by a NUL; member
+        //            names are stored once
+        struct snapshot_header {
+            char magic[4];             // "TJSB"
+            unsigned int byte_order;   // 0x01020304 as written
+            unsigned int version;
+            unsigned int node_count;
+            unsigned int keys_offset;
+            unsigned int keys_size;
+            unsigned int strings_offset;
+            unsigned int strings_size;
+            unsigned int total_size;
+            unsigned int reserved;
+        };
+
+        enum {
+            snapshot_version = 1,
+            snapshot_byte_order = 0x01020304,
+            snapshot_node_size = 16
+        };
+
+        // Reference counts that copies of a document on different threads
+        // may update together
+        inline long atomic_increment(volatile long* value) {
+#if defined(TINYJSON_NO_THREADS)
+            return ++*value;
+#elif defined(_WIN32) || defined(_XBOX)
+            return InterlockedIncrement(value);
+#else
+            return __sync_add_and_fetch(value, 1);
+#endif
+        }
+
+        inline long atomic_decrement(volatile long* value) {
+#if defined(TINYJSON_NO_THREADS)
+            return --*value;
+#elif defined(_WIN32) || defined(_XBOX)
+            return InterlockedDecrement(value);
+#else
+            return __sync_sub_and_fetch(value, 1);
+#endif
+        }
+
+        inline long long atomic_increment(volatile long long* value) {
+#if defined(TINYJSON_NO_THREADS)
+            return ++*value;
+#elif defined(_WIN32) || defined(_XBOX)
+            return InterlockedIncrement64(value);
+#else
+            return __sync_add_and_fetch(value, 1);
+#endif
+        }
+
+        // Untorn read of a 64-bit counter that other threads advance
+        inline long long atomic_read(volatile long long* value) {
+#if defined(TINYJSON_NO_THREADS)
+            return *value;
+#elif defined(_WIN32) || defined(_XBOX)
+            return InterlockedCompareExchange64(value, 0, 0);
+#else
+            return __sync_fetch_and_add(value, 0);
+#endif
+        }
+
+        // Publishing a field that other threads read without a lock: the
+        // store comes after everything it guards, the load before
+        template<typename T>
+        inline T load_acquire(const volatile T* value) {
+#if defined(TINYJSON_NO_THREADS)
+            return *value;
+#elif defined(_WIN32) || defined(_XBOX)
+            T result = *value;
+            MemoryBarrier();
+            return result;
+#else
+            return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+        }
+
+        template<typename T>
+        inline void store_release(volatile T* value, T result) {
+#if defined(TINYJSON_NO_THREADS)
+            *value = result;
+#elif defined(_WIN32) || defined(_XBOX)
+            MemoryBarrier();
+            *value = result;
+#else
+            __atomic_store_n(value, result, __ATOMIC_RELEASE);
+#endif
+        }
+
+#ifndef TINYJSON_NO_THREADS
+        class mutex {
+        public:
+#if defined(_WIN32) || defined(_XBOX)
+            mutex() { InitializeCriticalSection(&m_cs); }
+            ~mutex() { DeleteCriticalSection(&m_cs); }
+            void lock() { EnterCriticalSection(&m_cs); }
+            void unlock() { LeaveCriticalSection(&m_cs); }
+        private:
+            CRITICAL_SECTION m_cs;
+#else
+            mutex() { pthread_mutex_init(&m_mutex, nullptr); }
+            ~mutex() { pthread_mutex_destroy(&m_mutex); }
+            void lock() { pthread_mutex_lock(&m_mutex); }
+            void unlock() { pthread_mutex_unlock(&m_mutex); }
+        private:
+            pthread_mutex_t m_mutex;
+#endif
+            mutex(const mutex&);
+            mutex& operator=(const mutex&);
+        };
+
+        class lock_guard {
+        public:
+            explicit lock_guard(mutex& m) : m_mutex(m) { m_mutex.lock(); }
+            ~lock_guard() { m_mutex.unlock(); }
+        private:
+            mutex& m_mutex;
+            lock_guard(const lock_guard&);
+            lock_guard& operator=(const lock_guard&);
+        };
+
+        // Auto-reset event: wait() returns once signal() was called (or on timeout)
+        class event {
+        public:
+#if defined(_WIN32) || defined(_XBOX)
+            event() { m_handle = CreateEventA(nullptr, FALSE, FALSE, nullptr); }
+            ~event() { CloseHandle(m_handle); }
+            void signal() { SetEvent(m_handle); }
+            void wait(unsigned int timeout_ms) { WaitForSingleObject(m_handle, timeout_ms); }
+        private:
+            HANDLE m_handle;
+#else
+            event() : m_signaled(false) {
+                pthread_mutex_init(&m_mutex, nullptr);
+                pthread_cond_init(&m_cond, nullptr);
+            }
+            ~event() {
+                pthread_cond_destroy(&m_cond);
+                pthread_mutex_destroy(&m_mutex);
+            }
+            void signal() {
+                pthread_mutex_lock(&m_mutex);
+                m_signaled = true;
+                pthread_cond_signal(&m_cond);
+                pthread_mutex_unlock(&m_mutex);
+            }
+            void wait(unsigned int timeout_ms) {
+                timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += timeout_ms / 1000;
+                deadline.tv_nsec += static_cast<long>(timeout_ms % 1000) * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                    deadline.tv_sec += 1;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                pthread_mutex_lock(&m_mutex);
+                while (!m_signaled) {
+                    if (pthread_cond_timedwait(&m_cond, &m_mutex, &deadline) != 0) break;
+                }
+                m_signaled = false;
+                pthread_mutex_unlock(&m_mutex);
+            }
+        private:
+            pthread_mutex_t m_mutex;
+            pthread_cond_t m_cond;
+            bool m_signaled;
+#endif
+            event(const event&);
+            event& operator=(const event&);
+        };
+
+        class thread {
+        public:
+            typedef void (*entry_t)(void*);
+
+            thread() : m_started(false), m_entry(nullptr), m_arg(nullptr) {}
+
+            bool start(entry_t entry, void* arg) {
+                m_entry = entry;
+                m_arg = arg;
+#if defined(_WIN32) || defined(_XBOX)
+                m_handle = CreateThread(nullptr, 0, &thread::trampoline, this, 0, nullptr);
+                m_started = m_handle != nullptr;
+#else
+                m_started = pthread_create(&m_handle, nullptr, &thread::trampoline, this) == 0;
+#endif
+                return m_started;
+            }
+
+            void join() {
+                if (!m_started) return;
+#if defined(_WIN32) || defined(_XBOX)
+                WaitForSingleObject(m_handle, INFINITE);
+                CloseHandle(m_handle);
+#else
+                pthread_join(m_handle, nullptr);
+#endif
+                m_started = false;
+            }
+
+        private:
+#if defined(_WIN32) || defined(_XBOX)
+            HANDLE m_handle;
+            static DWORD WINAPI trampoline(LPVOID self) {
+                static_cast<thread*>(self)->m_entry(static_cast<thread*>(self)->m_arg);
+                return 0;
+            }
+#else
+            pthread_t m_handle;
+            static void* trampoline(void* self) {
+                static_cast<thread*>(self)->m_entry(static_cast<thread*>(self)->m_arg);
+                return nullptr;
+            }
+#endif
+            bool m_started;
+            entry_t m_entry;
+            void* m_arg;
+
+            thread(const thread&);
+            thread& operator=(const thread&);
+        };
+
+        // Number of hardware threads, at least 1
+        inline unsigned int hardware_threads() {
+#if defined(_XBOX)
+            return 6;
+#elif defined(_WIN32)
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return info.dwNumberOfProcessors > 0 ? static_cast<unsigned int>(info.dwNumberOfProcessors) : 1;
+#else
+            long count = sysconf(_SC_NPROCESSORS_ONLN);
+            return count > 0 ? static_cast<unsigned int>(count) : 1;
+#endif
+        }
+#else
+        // Single-threaded builds have nothing to lock
+        class mutex {
+        public:
+            void lock() {}
+            void unlock() {}
+        };
+
+        class lock_guard {
+        public:
+            explicit lock_guard(mutex&) {}
+        };
+#endif
+    }
+}
+
 namespace tinyjson {
     class json;
+    template<typename Sink> class json_cbor_writer;
 }
 
 namespace tinyjson {
@@ -31,6 +629,135 @@ namespace tinyjson {
         out_of_range(const std::string& msg) : json_exception(msg) {}
     };
 
+    // RFC 6901 JSON Pointer (e.g. "/player/stats/health" or "/a~1b/0").
+    // Compile once and reuse: tokens are unescaped and array indices are
+    // decoded up front, so lookups through json::find_pointer() never allocate.
+    class json_pointer {
+    public:
+        static const size_t npos = static_cast<size_t>(-1);
+
+        json_pointer() {}
+
+        explicit json_pointer(const std::string& pointer) {
+            compile(pointer.c_str(), pointer.length());
+        }
+
+        explicit json_pointer(const char* pointer) {
+            std::string str(pointer);
+            compile(str.c_str(), str.length());
+        }
+
+        // Number of reference tokens ("" has none and refers to the whole document)
+        size_t depth() const { return m_tokens.size(); }
+        bool empty() const { return m_tokens.empty(); }
+
+        // Unescaped reference token
+        const std::string& token(size_t i) const { return m_tokens[i].key; }
+
+        // Array index of a token, or npos when the token is not a valid index
+        size_t index(size_t i) const { return m_tokens[i].index; }
+
+        // True for the "-" token (the element past the end of an array)
+        bool is_append(size_t i) const { return m_tokens[i].append; }
+
+        // Re-escaped pointer string
+        std::string to_string() const {
+            std::string result;
+            for (size_t i = 0; i < m_tokens.size(); ++i) {
+                result += '/';
+                const std::string& key = m_tokens[i].key;
+                for (size_t j = 0; j < key.length(); ++j) {
+                    if (key[j] == '~') result += "~0";
+                    else if (key[j] == '/') result += "~1";
+                    else result += key[j];
+                }
+            }
+            return result;
+        }
+
+        // Append a single unescaped token
+        json_pointer& push_back(const std::string& key) {
+            token_t tok;
+            tok.key = key;
+            tok.index = parse_index(key);
+            tok.append = (key == "-");
+            m_tokens.push_back(tok);
+            return *this;
+        }
+
+        void pop_back() {
+            if (!m_tokens.empty()) m_tokens.pop_back();
+        }
+
+        bool operator==(const json_pointer& other) const {
+            if (m_tokens.size() != other.m_tokens.size()) return false;
+            for (size_t i = 0; i < m_tokens.size(); ++i) {
+                if (m_tokens[i].key != other.m_tokens[i].key) return false;
+            }
+            return true;
+        }
+
+        bool operator!=(const json_pointer& other) const {
+            return !(*this == other);
+        }
+
+        // Strict weak ordering so pointers can be used as std::map keys
+        bool operator<(const json_pointer& other) const {
+            size_t n = m_tokens.size() < other.m_tokens.size() ? m_tokens.size() : other.m_tokens.size();
+            for (size_t i = 0; i < n; ++i) {
+                int cmp = m_tokens[i].key.compare(other.m_tokens[i].key);
+                if (cmp != 0) return cmp < 0;
+            }
+            return m_tokens.size() < other.m_tokens.size();
+        }
+
+    private:
+        struct token_t {
+            std::string key;
+            size_t index;
+            bool append;
+        };
+
+        std::vector<token_t> m_tokens;
+
+        void compile(const char* pointer, size_t length) {
+            if (length == 0) return;
+            if (pointer[0] != '/') throw parse_error("json pointer must start with '/'");
+
+            std::string key;
+            for (size_t i = 1; i <= length; ++i) {
+                if (i == length || pointer[i] == '/') {
+                    push_back(key);
+                    key.clear();
+                }
+                else if (pointer[i] == '~') {
+                    if (i + 1 >= length) throw parse_error("invalid json pointer escape");
+                    if (pointer[i + 1] == '0') key += '~';
+                    else if (pointer[i + 1] == '1') key += '/';
+                    else throw parse_error("invalid json pointer escape");
+                    ++i;
+                }
+                else {
+                    key += pointer[i];
+                }
+            }
+        }
+
+        // RFC 6901 array index: "0" or a digit sequence without leading zeros
+        static size_t parse_index(const std::string& key) {
+            if (key.empty() || key.length() > 19) return npos;
+            if (key[0] == '0' && key.length() > 1) return npos;
+            size_t result = 0;
+            for (size_t i = 0; i < key.length(); ++i) {
+                if (key[i] < '0' || key[i] > '9') return npos;
+                size_t digit = static_cast<size_t>(key[i] - '0');
+                if (result > (npos - 1 - digit) / 10) return npos;
+                result = result * 10 + digit;
+            }
+            return result;
+        }
+    };
+
     class json {
     public:
         // Type definitions
@@ -41,7 +768,8 @@ namespace tinyjson {
             string,
             boolean,
             number_integer,
-            number_float
+            number_float,
+            raw             // unparsed source text, see parse_options
         };
 
         // Custom iterator for ordered object
@@ -106,110 +834,121 @@ namespace tinyjson {
         };
 
         // Constructors
-        json() : m_type(null), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json() : m_type(null), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_value.number_integer = 0;
         }
 
-        json(void* null_ptr) : m_type(null), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(void* null_ptr) : m_type(null), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             (void)null_ptr;
             m_value.number_integer = 0;
         }
 
-        json(bool val) : m_type(boolean), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(bool val) : m_type(boolean), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_value.boolean = val;
         }
 
-        json(int val) : m_type(number_integer), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(int val) : m_type(number_integer), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_value.number_integer = static_cast<long long>(val);
         }
 
-        json(long long val) : m_type(number_integer), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(long long val) : m_type(number_integer), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_value.number_integer = val;
         }
 
-        json(double val) : m_type(number_float), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(double val) : m_type(number_float), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_value.number_float = val;
         }
 
-        json(const std::string& val) : m_type(string), m_object(nullptr), m_array(nullptr) {
+        json(const std::string& val) : m_type(string), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_string = new std::string(val);
             m_value.number_integer = 0;
         }
 
-        json(const char* val) : m_type(string), m_object(nullptr), m_array(nullptr) {
+        json(const char* val) : m_type(string), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_string = new std::string(val);
             m_value.number_integer = 0;
         }
 
-        json(unsigned int val) : m_type(number_integer), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(unsigned int val) : m_type(number_integer), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_value.number_integer = static_cast<long long>(val);
         }
 
-        json(unsigned long long val) : m_type(number_integer), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(unsigned long long val) : m_type(number_integer), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             m_value.number_integer = static_cast<long long>(val);
         }
 
         // Copy constructor
-        json(const json& other) : m_type(other.m_type), m_string(nullptr), m_object(nullptr), m_array(nullptr) {
+        json(const json& other) : m_type(other.load_type()), m_generation(0), m_string(nullptr), m_fragment(nullptr), m_source(nullptr) {
             copy_from(other);
         }
 
         // Destructor
         ~json() {
-            clear();
+            release();
         }
 
         // Assignment operator
         json& operator=(const json& other) {
             if (this != &other) {
                 clear();
-                m_type = other.m_type;
+                m_type = other.load_type();
                 copy_from(other);
             }
             return *this;
         }
 
         // Type checking
-        bool is_null() const { return m_type == null; }
-        bool is_boolean() const { return m_type == boolean; }
-        bool is_number() const { return m_type == number_integer || m_type == number_float; }
-        bool is_string() const { return m_type == string; }
-        bool is_array() const { return m_type == array; }
-        bool is_object() const { return m_type == object; }
+        bool is_null() const { resolve(); return m_type == null; }
+        bool is_boolean() const { resolve(); return m_type == boolean; }
+        bool is_number() const { resolve(); return m_type == number_integer || m_type == number_float; }
+        bool is_string() const { resolve(); return m_type == string; }
+        bool is_array() const { resolve(); return m_type == array; }
+        bool is_object() const { resolve(); return m_type == object; }
+
+        // Still unparsed text (parse_options::raw_paths, raw_fragment()).
+        // Every other accessor parses a raw value first; dump() doesn't.
+        bool is_raw() const { return load_type() == raw; }
 
         // Value getters
         bool get_bool() const {
+            resolve();
             if (m_type != boolean) throw parse_error("not a boolean");
             return m_value.boolean;
         }
 
         long long get_int() const {
-            if (m_type == number_integer) return m_value.number_integer;
-            if (m_type == number_float) return static_cast<long long>(m_value.number_float);
+            resolve();
+            if (m_type == number_integer) return integer_value();
+            if (m_type == number_float) return static_cast<long long>(float_value());
             throw parse_error("not a number");
         }
 
         double get_float() const {
-            if (m_type == number_float) return m_value.number_float;
-            if (m_type == number_integer) return static_cast<double>(m_value.number_integer);
+            resolve();
+            if (m_type == number_float) return float_value();
+            if (m_type == number_integer) return static_cast<double>(integer_value());
             throw parse_error("not a number");
         }
 
         const std::string& get_string() const {
+            resolve();
             if (m_type != string) throw parse_error("not a string");
-            return *m_string;
+            return string_value();
         }
 
         // Comparison operators
         bool operator==(const json& other) const {
+            resolve();
+            other.resolve();
             if (m_type != other.m_type) return false;
 
             switch (m_type) {
             case null: return true;
             case boolean: return m_value.boolean == other.m_value.boolean;
-            case number_integer: return m_value.number_integer == other.m_value.number_integer;
-            case number_float: return m_value.number_float == other.m_value.number_float;
-            case string: return *m_string == *other.m_string;
+            case number_integer: return integer_value() == other.integer_value();
+            case number_float: return float_value() == other.float_value();
+            case raw: break;
+            case string: return string_value() == other.string_value();
             case array: return *m_array == *other.m_array;
             case object: {
                 if (m_object->size() != other.m_object->size()) return false;
@@ -231,9 +970,11 @@ namespace tinyjson {
 
         // Object access operators
         json& operator[](const std::string& key) {
+            touch();
             if (m_type == null) {
                 m_type = object;
                 m_object = new std::vector<std::pair<std::string, json>>();
+                bump_generation();
             }
             if (m_type != object) throw parse_error("not an object");
 
@@ -245,11 +986,14 @@ namespace tinyjson {
             }
 
             // Key not found, add new entry
-            m_object->push_back(std::make_pair(key, json()));
-            return m_object->back().second;
+            std::pair<std::string, json>& member = append_slot(*m_object);
+            member.first = key;
+            bump_generation();
+            return member.second;
         }
 
         const json& operator[](const std::string& key) const {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
 
             for (size_t i = 0; i < m_object->size(); ++i) {
@@ -262,16 +1006,22 @@ namespace tinyjson {
 
         // Array access operators
         json& operator[](size_t index) {
+            touch();
             if (m_type == null) {
                 m_type = array;
                 m_array = new std::vector<json>();
+                bump_generation();
             }
             if (m_type != array) throw parse_error("not an array");
-            if (index >= m_array->size()) m_array->resize(index + 1);
+            if (index >= m_array->size()) {
+                m_array->resize(index + 1);
+                bump_generation();
+            }
             return (*m_array)[index];
         }
 
         const json& operator[](size_t index) const {
+            resolve();
             if (m_type != array) throw parse_error("not an array");
             if (index >= m_array->size()) throw parse_error("index out of range");
             return (*m_array)[index];
@@ -279,7 +1029,9 @@ namespace tinyjson {
 
         // Checked access methods
         json& at(const std::string& key) {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
+            touch();
 
             for (size_t i = 0; i < m_object->size(); ++i) {
                 if ((*m_object)[i].first == key) {
@@ -290,13 +1042,16 @@ namespace tinyjson {
         }
 
         json& at(size_t index) {
+            resolve();
             if (m_type != array) throw parse_error("not an array");
+            touch();
             if (index >= m_array->size()) throw parse_error("index out of range");
             return (*m_array)[index];
         }
 
         // Object methods
         bool contains(const std::string& key) const {
+            resolve();
             if (m_type != object) return false;
             for (size_t i = 0; i < m_object->size(); ++i) {
                 if ((*m_object)[i].first == key) {
@@ -308,10 +1063,13 @@ namespace tinyjson {
 
         // Remove a key from object (returns true if key was found and removed)
         bool erase(const std::string& key) {
+            resolve();
             if (m_type != object) return false;
+            touch();
             for (size_t i = 0; i < m_object->size(); ++i) {
                 if ((*m_object)[i].first == key) {
                     m_object->erase(m_object->begin() + i);
+                    bump_generation();
                     return true;
                 }
             }
@@ -319,27 +1077,35 @@ namespace tinyjson {
         }
 
         iterator begin() {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
+            touch();
             return iterator(m_object, 0);
         }
 
         const_iterator begin() const {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
             return const_iterator(m_object, 0);
         }
 
         iterator end() {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
+            touch();
             return iterator(m_object, m_object->size());
         }
 
         const_iterator end() const {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
             return const_iterator(m_object, m_object->size());
         }
 
         iterator find(const std::string& key) {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
+            touch();
             for (size_t i = 0; i < m_object->size(); ++i) {
                 if ((*m_object)[i].first == key) {
                     return iterator(m_object, i);
@@ -349,6 +1115,7 @@ namespace tinyjson {
         }
 
         const_iterator find(const std::string& key) const {
+            resolve();
             if (m_type != object) throw parse_error("not an object");
             for (size_t i = 0; i < m_object->size(); ++i) {
                 if ((*m_object)[i].first == key) {
@@ -360,31 +1127,64 @@ namespace tinyjson {
 
         // Array methods
         void push_back(const json& value) {
+            touch();
             if (m_type == null) {
                 m_type = array;
                 m_array = new std::vector<json>();
             }
             if (m_type != array) throw parse_error("not an array");
             m_array->push_back(value);
+            bump_generation();
+        }
+
+        // Make room for n elements or members, so that filling the container
+        // doesn't reallocate. A null value becomes an empty container of the
+        // given type (array or object) first.
+        void reserve(size_t n, value_t type = array) {
+            touch();
+            if (m_type == null) {
+                if (type == array) {
+                    m_type = array;
+                    m_array = new std::vector<json>();
+                }
+                else if (type == object) {
+                    m_type = object;
+                    m_object = new std::vector<std::pair<std::string, json>>();
+                }
+                else {
+                    throw parse_error("can only reserve arrays and objects");
+                }
+                bump_generation();
+            }
+            bool moved;
+            if (m_type == array) moved = grow_slots(*m_array, n);
+            else if (m_type == object) moved = grow_slots(*m_object, n);
+            else throw parse_error("can only reserve arrays and objects");
+
+            // The children live at new addresses now
+            if (moved) bump_generation();
         }
 
         size_t size() const {
+            resolve();
             if (m_type == array) return m_array->size();
             if (m_type == object) return m_object->size();
-            if (m_type == string) return m_string->size();
+            if (m_type == string) return string_length();
             return 0;
         }
 
         bool empty() const {
+            resolve();
             if (m_type == array) return m_array->empty();
             if (m_type == object) return m_object->empty();
-            if (m_type == string) return m_string->empty();
+            if (m_type == string) return string_length() == 0;
             return true;
         }
 
         // Get value with default - safe access with type checking
         template<typename T>
         T value(const std::string& key, const T& default_val) const {
+            resolve();
             if (m_type != object) return default_val;
 
             for (size_t i = 0; i < m_object->size(); ++i) {
@@ -401,6 +1201,8 @@ namespace tinyjson {
             json* current = this;
 
             for (size_t i = 0; i < parts.size(); ++i) {
+                current->touch();
+
                 // Check if this part is a number (array index)
                 bool is_index = is_numeric(parts[i]);
 
@@ -442,6 +1244,7 @@ namespace tinyjson {
             const json* current = this;
 
             for (size_t i = 0; i < parts.size(); ++i) {
+                current->resolve();
                 bool is_index = is_numeric(parts[i]);
 
                 if (is_index) {
@@ -495,6 +1298,7 @@ namespace tinyjson {
 
             // Navigate/create path to second-to-last element
             for (size_t i = 0; i < parts.size() - 1; ++i) {
+                current->touch();
                 bool is_index = is_numeric(parts[i]);
 
                 if (is_index) {
@@ -511,6 +1315,7 @@ namespace tinyjson {
                     if (current->m_type == null) {
                         current->m_type = object;
                         current->m_object = new std::vector<std::pair<std::string, json>>();
+                        current->bump_generation();
                     }
 
                     if (current->m_type != object) {
@@ -527,13 +1332,16 @@ namespace tinyjson {
                     }
 
                     if (!found) {
-                        current->m_object->push_back(std::make_pair(parts[i], json()));
-                        current = &current->m_object->back().second;
+                        std::pair<std::string, json>& member = append_slot(*current->m_object);
+                        member.first = parts[i];
+                        current->bump_generation();
+                        current = &member.second;
                     }
                 }
             }
 
             // Set the final value
+            current->touch();
             bool last_is_index = is_numeric(parts.back());
 
             if (last_is_index) {
@@ -550,6 +1358,7 @@ namespace tinyjson {
                 if (current->m_type == null) {
                     current->m_type = object;
                     current->m_object = new std::vector<std::pair<std::string, json>>();
+                    current->bump_generation();
                 }
 
                 if (current->m_type != object) {
@@ -572,109 +1381,694 @@ namespace tinyjson {
             }
         }
 
-        void clear() {
-            if (m_string) {
-                delete m_string;
-                m_string = nullptr;
-            }
-            if (m_object) {
-                delete m_object;
-                m_object = nullptr;
-            }
-            if (m_array) {
-                delete m_array;
-                m_array = nullptr;
-            }
-            m_type = null;
-            m_value.number_integer = 0;
+        // JSON Pointer access (RFC 6901). Unlike dotted paths, object keys may
+        // contain '.' and all-digit tokens are only treated as indices on arrays.
+        const json* find_pointer(const json_pointer& ptr) const {
+            return resolve_pointer(ptr, ptr.depth());
         }
 
-        // Serialization
-        std::string dump(int indent = -1, int current_indent = 0) const {
-            std::string result;
+        json* find_pointer(const json_pointer& ptr) {
+            return resolve_pointer(ptr, ptr.depth());
+        }
 
-            switch (m_type) {
-            case null:
-                result = "null";
-                break;
-            case boolean:
-                result = m_value.boolean ? "true" : "false";
-                break;
-            case number_integer:
-                result = int_to_string(m_value.number_integer);
-                break;
-            case number_float: {
-                char buffer[64];
-                sprintf(buffer, "%.17g", m_value.number_float);
-                result = buffer;
-                break;
+        const json& at_pointer(const json_pointer& ptr) const {
+            const json* result = find_pointer(ptr);
+            if (!result) throw parse_error("pointer not found: " + ptr.to_string());
+            return *result;
+        }
+
+        json& at_pointer(const json_pointer& ptr) {
+            json* result = find_pointer(ptr);
+            if (!result) throw parse_error("pointer not found: " + ptr.to_string());
+            return *result;
+        }
+
+        bool has_pointer(const json_pointer& ptr) const {
+            return find_pointer(ptr) != nullptr;
+        }
+
+        // Set value via pointer, creating intermediate objects for missing keys.
+        // On arrays the final token may be "-" or equal to size() to append.
+        void set_pointer(const json_pointer& ptr, const json& value) {
+            if (ptr.empty()) {
+                *this = value;
+                return;
             }
-            case string:
-                result = "\"" + escape_string(*m_string) + "\"";
-                break;
-            case array: {
-                result = "[";
-                if (indent >= 0 && !m_array->empty()) {
-                    result += "\n";
-                }
-                for (size_t i = 0; i < m_array->size(); ++i) {
-                    if (indent >= 0) {
-                        result += std::string((current_indent + indent), ' ');
-                    }
-                    result += (*m_array)[i].dump(indent, current_indent + indent);
-                    if (i < m_array->size() - 1) {
-                        result += ",";
-                    }
-                    if (indent >= 0) {
-                        result += "\n";
-                    }
-                }
-                if (indent >= 0 && !m_array->empty()) {
-                    result += std::string(current_indent, ' ');
+
+            json* current = this;
+            size_t last = ptr.depth() - 1;
+
+            for (size_t i = 0; i <= last; ++i) {
+                current->touch();
+                if (current->m_type == null) {
+                    current->m_type = object;
+                    current->m_object = new std::vector<std::pair<std::string, json>>();
+                    current->bump_generation();
                 }
-                result += "]";
-                break;
-            }
-            case object: {
-                result = "{";
-                if (indent >= 0 && !m_object->empty()) {
-                    result += "\n";
+
+                if (current->m_type == object) {
+                    current = &(*current)[ptr.token(i)];
                 }
-                for (size_t i = 0; i < m_object->size(); ++i) {
-                    if (indent >= 0) {
-                        result += std::string((current_indent + indent), ' ');
-                    }
-                    result += "\"" + escape_string((*m_object)[i].first) + "\":";
-                    if (indent >= 0) {
-                        result += " ";
+                else if (current->m_type == array) {
+                    size_t size = current->m_array->size();
+                    size_t index = ptr.is_append(i) ? size : ptr.index(i);
+                    if (index == json_pointer::npos) {
+                        throw parse_error("invalid array index in pointer: " + ptr.to_string());
                     }
-                    result += (*m_object)[i].second.dump(indent, current_indent + indent);
-                    if (i < m_object->size() - 1) {
-                        result += ",";
+                    if (index > size || (index == size && i != last)) {
+                        throw parse_error("array index out of range");
                     }
-                    if (indent >= 0) {
-                        result += "\n";
+                    if (index == size) {
+                        current->m_array->push_back(value);
+                        current->bump_generation();
+                        return;
                     }
+                    current = &(*current->m_array)[index];
                 }
-                if (indent >= 0 && !m_object->empty()) {
-                    result += std::string(current_indent, ' ');
+                else {
+                    throw parse_error("path element is not an object or array");
                 }
-                result += "}";
-                break;
-            }
             }
 
-            return result;
+            *current = value;
         }
 
-        // Parsing
-        static json parse(const std::string& str) {
-            size_t pos = 0;
-            skip_whitespace(str, pos);
-            if (pos >= str.length()) throw parse_error("empty input");
-            json result = parse_value(str, pos);
-            skip_whitespace(str, pos);
-            if (pos < str.length()) throw parse_error("unexpected data after JSON");
+        // Remove the value a pointer refers to (returns true if it existed)
+        bool erase_pointer(const json_pointer& ptr) {
+            if (ptr.empty()) return false;
+
+            size_t last = ptr.depth() - 1;
+            json* parent = resolve_pointer(ptr, last);
+            if (!parent) return false;
+            parent->resolve();
+
+            if (parent->m_type == object) {
+                return parent->erase(ptr.token(last));
+            }
+            if (parent->m_type == array) {
+                size_t index = ptr.index(last);
+                if (index >= parent->m_array->size()) return false;
+                parent->m_array->erase(parent->m_array->begin() + index);
+                parent->bump_generation();
+                return true;
+            }
+            return false;
+        }
+
+        // Pointer-based value with default
+        template<typename T>
+        T value_at_pointer(const json_pointer& ptr, const T& default_val) const {
+            const json* val = find_pointer(ptr);
+            if (!val) return default_val;
+            return get_value_helper<T>(*val, default_val);
+        }
+
+        void clear() {
+            release();
+            bump_generation();
+        }
+
+        // Generation of this value: advanced by every operation that can move
+        // or replace its children (operator[] insert, erase, push_back,
+        // set_path, clear, assignment). Two equal readings mean references to
+        // its children are still valid, as long as fewer than 2^32 such
+        // operations on this value happened in between.
+        unsigned int generation() const {
+            return m_generation;
+        }
+
+        // Serialization
+        std::string dump(int indent = -1, int current_indent = 0) const {
+            std::string result;
+            string_sink out(result);
+            serialize(out, indent, current_indent);
+            return result;
+        }
+
+        // Exact number of bytes dump(indent) produces (escapes, number widths
+        // and indentation included)
+        size_t serialized_size(int indent = -1) const {
+            size_sink counter;
+            serialize(counter, indent, 0);
+            return counter.size;
+        }
+
+        // Serialize into a caller-supplied buffer without touching the heap.
+        // Returns the number of bytes required; the buffer is only written
+        // (without a terminating NUL) when that is <= capacity.
+        size_t dump_to(char* buffer, size_t capacity, int indent = -1) const {
+            size_t required = serialized_size(indent);
+            if (required <= capacity) {
+                buffer_sink out(buffer);
+                serialize(out, indent, 0);
+            }
+            return required;
+        }
+
+#ifndef TINYJSON_NO_THREADS
+        // dump() spread over several threads (0 = one per hardware thread).
+        // Large arrays and objects are cut into runs of elements that are
+        // serialized concurrently and joined in order, so the output is
+        // byte-identical to dump(). The calling thread takes part; the
+        // document must not be modified until it returns.
+        std::string dump_parallel(int indent = -1, unsigned int threads = 0) const {
+            if (threads == 0) threads = detail::hardware_threads();
+            if (threads < 2) return dump(indent);
+
+            parallel_job job;
+            plan_parallel(job.pieces, indent, 0, threads, 0);
+            for (size_t i = 0; i < job.pieces.size(); ++i) {
+                if (job.pieces[i].node) job.tasks.push_back(i);
+            }
+            if (job.tasks.size() < 2) return dump(indent);
+
+            size_t worker_count = threads - 1;
+            if (worker_count > job.tasks.size() - 1) worker_count = job.tasks.size() - 1;
+            detail::thread* workers = new detail::thread[worker_count];
+            for (size_t i = 0; i < worker_count; ++i) {
+                workers[i].start(&json::parallel_worker, &job);
+            }
+            parallel_worker(&job);
+            for (size_t i = 0; i < worker_count; ++i) {
+                workers[i].join();
+            }
+            delete[] workers;
+
+            size_t total = 0;
+            for (size_t i = 0; i < job.pieces.size(); ++i) {
+                total += job.pieces[i].text.length();
+            }
+            std::string result;
+            result.reserve(total);
+            for (size_t i = 0; i < job.pieces.size(); ++i) {
+                result += job.pieces[i].text;
+            }
+            return result;
+        }
+#endif
+
+        // Like dump(), but remembers the serialized bytes of subtrees and reuses
+        // them on the next call for every subtree that hasn't changed since.
+        // Output is identical to dump(). A fragment is checked against the
+        // generation() of every node it covers, so changes made through
+        // references kept across calls are seen too.
+        std::string dump_incremental(int indent = -1) {
+            std::string result;
+            serialize_incremental(result, indent, 0);
+            return result;
+        }
+
+        // Forget every remembered fragment (the next dump_incremental() starts over)
+        void drop_serialization_cache() {
+            touch();
+            if (m_type == array) {
+                for (size_t i = 0; i < m_array->size(); ++i) {
+                    (*m_array)[i].drop_serialization_cache();
+                }
+            }
+            else if (m_type == object) {
+                for (size_t i = 0; i < m_object->size(); ++i) {
+                    (*m_object)[i].second.drop_serialization_cache();
+                }
+            }
+        }
+
+        // MessagePack. Object members keep their order; integers use the
+        // smallest encoding that holds them, floats are written as float64.
+        std::string to_msgpack() const {
+            std::string result;
+            string_sink out(result);
+            to_msgpack(out);
+            return result;
+        }
+
+        // Stream the encoding to any sink with append(const char* data, size_t length)
+        template<typename Sink>
+        void to_msgpack(Sink& out) const {
+            resolve();
+            switch (m_type) {
+            case null:
+                out.append("\xc0", 1);
+                break;
+            case boolean:
+                out.append(m_value.boolean ? "\xc3" : "\xc2", 1);
+                break;
+            case number_integer: {
+                long long value = integer_value();
+                if (value >= 0) {
+                    if (value < 128) write_be(out, static_cast<unsigned char>(value), 0, 0);
+                    else if (value <= 0xFF) write_be(out, 0xcc, static_cast<unsigned long long>(value), 1);
+                    else if (value <= 0xFFFF) write_be(out, 0xcd, static_cast<unsigned long long>(value), 2);
+                    else if (value <= 0xFFFFFFFFLL) write_be(out, 0xce, static_cast<unsigned long long>(value), 4);
+                    else write_be(out, 0xcf, static_cast<unsigned long long>(value), 8);
+                }
+                else {
+                    unsigned long long bits = static_cast<unsigned long long>(value);
+                    if (value >= -32) write_be(out, static_cast<unsigned char>(value), 0, 0);
+                    else if (value >= -128) write_be(out, 0xd0, bits, 1);
+                    else if (value >= -32768) write_be(out, 0xd1, bits, 2);
+                    else if (value >= -2147483647LL - 1) write_be(out, 0xd2, bits, 4);
+                    else write_be(out, 0xd3, bits, 8);
+                }
+                break;
+            }
+            case number_float: {
+                double value = float_value();
+                unsigned long long bits;
+                memcpy(&bits, &value, sizeof(bits));
+                write_be(out, 0xcb, bits, 8);
+                break;
+            }
+            case raw:   // resolved above
+                break;
+            case string: {
+                size_t length = string_length();
+                if (length < 32) write_be(out, static_cast<unsigned char>(0xa0 | length), 0, 0);
+                else if (length <= 0xFF) write_be(out, 0xd9, length, 1);
+                else if (length <= 0xFFFF) write_be(out, 0xda, length, 2);
+                else write_be(out, 0xdb, msgpack_u32(length), 4);
+                out.append(string_data(), length);
+                break;
+            }
+            case array: {
+                size_t count = m_array->size();
+                if (count < 16) write_be(out, static_cast<unsigned char>(0x90 | count), 0, 0);
+                else if (count <= 0xFFFF) write_be(out, 0xdc, count, 2);
+                else write_be(out, 0xdd, msgpack_u32(count), 4);
+                for (size_t i = 0; i < count; ++i) {
+                    (*m_array)[i].to_msgpack(out);
+                }
+                break;
+            }
+            case object: {
+                size_t count = m_object->size();
+                if (count < 16) write_be(out, static_cast<unsigned char>(0x80 | count), 0, 0);
+                else if (count <= 0xFFFF) write_be(out, 0xde, count, 2);
+                else write_be(out, 0xdf, msgpack_u32(count), 4);
+                for (size_t i = 0; i < count; ++i) {
+                    const std::string& key = (*m_object)[i].first;
+                    size_t length = key.length();
+                    if (length < 32) write_be(out, static_cast<unsigned char>(0xa0 | length), 0, 0);
+                    else if (length <= 0xFF) write_be(out, 0xd9, length, 1);
+                    else if (length <= 0xFFFF) write_be(out, 0xda, length, 2);
+                    else write_be(out, 0xdb, msgpack_u32(length), 4);
+                    out.append(key.data(), length);
+                    (*m_object)[i].second.to_msgpack(out);
+                }
+                break;
+            }
+            }
+        }
+
+        // Decode straight from the caller's buffer (no copy of the input).
+        // bin is decoded as a string; ext types and non-string map keys throw
+        // parse_error. Unsigned values above LLONG_MAX become floats.
+        static json from_msgpack(const char* data, size_t length) {
+            size_t consumed = 0;
+            json result = from_msgpack(data, length, consumed);
+            if (consumed < length) throw parse_error("unexpected data after MessagePack value");
+            return result;
+        }
+
+        static json from_msgpack(const std::string& data) {
+            return from_msgpack(data.data(), data.length());
+        }
+
+        // Decode the first value only; consumed receives its size, so a
+        // stream of concatenated values can be read one after another
+        static json from_msgpack(const char* data, size_t length, size_t& consumed) {
+            size_t pos = 0;
+            json result;
+            read_msgpack(result, reinterpret_cast<const unsigned char*>(data), length, pos);
+            consumed = pos;
+            return result;
+        }
+
+        // CBOR (RFC 8949). Integers and lengths use the shortest head; floats
+        // use the smallest of float16/32/64 that holds the value exactly.
+        // Containers are written with definite lengths (see json_cbor_writer
+        // for streaming indefinite ones).
+        std::string to_cbor() const {
+            std::string result;
+            string_sink out(result);
+            to_cbor(out);
+            return result;
+        }
+
+        // Stream the encoding to any sink with append(const char* data, size_t length)
+        template<typename Sink>
+        void to_cbor(Sink& out) const {
+            resolve();
+            switch (m_type) {
+            case null:
+                out.append("\xf6", 1);
+                break;
+            case boolean:
+                out.append(m_value.boolean ? "\xf5" : "\xf4", 1);
+                break;
+            case number_integer: {
+                long long value = integer_value();
+                if (value >= 0) {
+                    write_cbor_head(out, 0, static_cast<unsigned long long>(value));
+                }
+                else {
+                    // -1 - n, computed without overflowing at LLONG_MIN
+                    write_cbor_head(out, 1, ~static_cast<unsigned long long>(value));
+                }
+                break;
+            }
+            case number_float:
+                write_cbor_float(out, float_value());
+                break;
+            case raw:   // resolved above
+                break;
+            case string:
+                write_cbor_head(out, 3, string_length());
+                out.append(string_data(), string_length());
+                break;
+            case array:
+                write_cbor_head(out, 4, m_array->size());
+                for (size_t i = 0; i < m_array->size(); ++i) {
+                    (*m_array)[i].to_cbor(out);
+                }
+                break;
+            case object:
+                write_cbor_head(out, 5, m_object->size());
+                for (size_t i = 0; i < m_object->size(); ++i) {
+                    const std::string& key = (*m_object)[i].first;
+                    write_cbor_head(out, 3, key.length());
+                    out.append(key.data(), key.length());
+                    (*m_object)[i].second.to_cbor(out);
+                }
+                break;
+            }
+        }
+
+        // Decode straight from the caller's buffer. Definite and indefinite
+        // lengths are accepted; byte strings become strings, tags are skipped,
+        // undefined becomes null. Non-string map keys throw parse_error.
+        static json from_cbor(const char* data, size_t length) {
+            size_t consumed = 0;
+            json result = from_cbor(data, length, consumed);
+            if (consumed < length) throw parse_error("unexpected data after CBOR value");
+            return result;
+        }
+
+        static json from_cbor(const std::string& data) {
+            return from_cbor(data.data(), data.length());
+        }
+
+        // Decode the first item only; consumed receives its size
+        static json from_cbor(const char* data, size_t length, size_t& consumed) {
+            size_t pos = 0;
+            json result;
+            read_cbor(result, reinterpret_cast<const unsigned char*>(data), length, pos);
+            consumed = pos;
+            return result;
+        }
+
+        // Binary snapshot for json_snapshot / json_view: position independent
+        // (offsets only), read in place without parsing. Native byte order;
+        // documents up to 4 GB.
+        std::string to_snapshot() const {
+            std::string nodes;
+            std::string keys;
+            std::string strings;
+            std::map<std::string, unsigned int> names;   // member names stored once
+
+            // Breadth-first, so each container's children get consecutive slots
+            std::vector<const json*> order(1, this);
+            for (size_t i = 0; i < order.size(); ++i) {
+                const json& node = *order[i];
+                node.resolve();
+                char record[detail::snapshot_node_size];
+                memset(record, 0, sizeof(record));
+                record[0] = static_cast<char>(node.m_type);
+
+                switch (node.m_type) {
+                case null:
+                    break;
+                case boolean:
+                    put_u32(record + 4, node.m_value.boolean ? 1 : 0);
+                    break;
+                case number_integer: {
+                    long long value = node.integer_value();
+                    memcpy(record + 8, &value, 8);
+                    break;
+                }
+                case number_float: {
+                    double value = node.float_value();
+                    memcpy(record + 8, &value, 8);
+                    break;
+                }
+                case raw:   // resolved above
+                    break;
+                case string:
+                    put_u32(record + 4, snapshot_string(strings, node.string_data(), node.string_length()));
+                    put_u32(record + 8, snapshot_u32(node.string_length()));
+                    break;
+                case array:
+                    put_u32(record + 4, snapshot_u32(node.m_array->size()));
+                    put_u32(record + 8, snapshot_u32(order.size()));
+                    for (size_t j = 0; j < node.m_array->size(); ++j) {
+                        order.push_back(&(*node.m_array)[j]);
+                    }
+                    break;
+                case object: {
+                    const std::vector<std::pair<std::string, json>>& members = *node.m_object;
+                    put_u32(record + 4, snapshot_u32(members.size()));
+                    put_u32(record + 8, snapshot_u32(order.size()));
+                    put_u32(record + 12, snapshot_u32(keys.size()));
+
+                    std::vector<unsigned int> sorted(members.size());
+                    for (size_t j = 0; j < members.size(); ++j) {
+                        const std::string& key = members[j].first;
+                        std::map<std::string, unsigned int>::iterator it = names.find(key);
+                        if (it == names.end()) {
+                            it = names.insert(std::make_pair(key, snapshot_string(strings, key.data(), key.length()))).first;
+                        }
+                        char entry[8];
+                        put_u32(entry, it->second);
+                        put_u32(entry + 4, snapshot_u32(key.length()));
+                        keys.append(entry, 8);
+                        sorted[j] = static_cast<unsigned int>(j);
+                        order.push_back(&members[j].second);
+                    }
+                    std::stable_sort(sorted.begin(), sorted.end(), member_less(members));
+                    for (size_t j = 0; j < sorted.size(); ++j) {
+                        char entry[4];
+                        put_u32(entry, sorted[j]);
+                        keys.append(entry, 4);
+                    }
+                    break;
+                }
+                }
+                nodes.append(record, sizeof(record));
+            }
+
+            detail::snapshot_header header;
+            memcpy(header.magic, "TJSB", 4);
+            header.byte_order = detail::snapshot_byte_order;
+            header.version = detail::snapshot_version;
+            header.node_count = snapshot_u32(order.size());
+            header.keys_offset = snapshot_u32(sizeof(header) + nodes.size());
+            header.keys_size = snapshot_u32(keys.size());
+            header.strings_offset = snapshot_u32(sizeof(header) + nodes.size() + keys.size());
+            header.strings_size = snapshot_u32(strings.size());
+            header.total_size = snapshot_u32(sizeof(header) + nodes.size() + keys.size() + strings.size());
+            header.reserved = 0;
+
+            std::string result;
+            result.reserve(header.total_size);
+            result.append(reinterpret_cast<const char*>(&header), sizeof(header));
+            result += nodes;
+            result += keys;
+            result += strings;
+            return result;
+        }
+
+        // Written like save_to_file_atomic(): the old file survives a crash
+        bool save_snapshot(const std::string& filepath) const {
+            std::string error_msg;
+            return save_snapshot_verbose(filepath, error_msg);
+        }
+
+        bool save_snapshot_verbose(const std::string& filepath, std::string& error_msg) const {
+            try {
+                std::string content = to_snapshot();
+                return detail::write_file_atomic(filepath, content.data(), content.length(), error_msg);
+            }
+            catch (const parse_error& e) {
+                error_msg = e.what();
+                return false;
+            }
+        }
+
+        // Mutable document from a snapshot file or buffer (see json_snapshot::to_json())
+        static json load_snapshot(const std::string& filepath);
+        static json from_snapshot(const char* data, size_t size);
+
+        // Parsing
+        static json parse(const std::string& str) {
+            size_t pos = 0;
+            skip_whitespace(str, pos);
+            if (pos >= str.length()) throw parse_error("empty input");
+            parse_context context;
+            count_elements(str.data(), str.length(), pos, context.sizes);
+            json result = parse_value(str, pos, &context);
+            skip_whitespace(str, pos);
+            if (pos < str.length()) throw parse_error("unexpected data after JSON");
+            return result;
+        }
+
+        // Parse str into target, reusing the storage target already has:
+        // arrays and objects keep their vectors and parse into the existing
+        // elements and member names, strings keep their buffers. Parsing a
+        // stream of same-shaped messages into one json stops allocating
+        // after the first. Values whose type changed are rebuilt. On
+        // parse_error target is left null.
+        static void parse_into(json& target, const std::string& str) {
+            try {
+                size_t pos = 0;
+                skip_whitespace(str, pos);
+                if (pos >= str.length()) throw parse_error("empty input");
+                parse_value_into(str, pos, target);
+                skip_whitespace(str, pos);
+                if (pos < str.length()) throw parse_error("unexpected data after JSON");
+            }
+            catch (...) {
+                target.clear();
+                throw;
+            }
+        }
+
+        // Options for parse(str, options)
+        struct parse_options {
+            // Subtrees kept as raw text (dotted paths or JSON Pointers): they are
+            // validated but not built, dump() copies them verbatim, and they are
+            // parsed in place on first access
+            std::vector<std::string> raw_paths;
+
+            // Numbers keep their source text: converted on each get_int() /
+            // get_float(), written back byte for byte by dump()
+            bool lazy_numbers;
+
+            // String values keep their source text: decoded on the first
+            // get_string(), written back byte for byte by dump(). Keys are
+            // always decoded.
+            bool lazy_strings;
+
+            parse_options() : lazy_numbers(false), lazy_strings(false) {}
+        };
+
+        static json parse(const std::string& str, const parse_options& options) {
+            // Every path returns result, so it is never copied on the way out
+            json result;
+            if (options.raw_paths.empty() && !options.lazy_numbers && !options.lazy_strings) {
+                json plain = parse(str);
+                result.take(plain);
+                return result;
+            }
+
+            std::vector<projection> tree(1);
+            for (size_t i = 0; i < options.raw_paths.size(); ++i) {
+                add_projection(tree, options.raw_paths[i]);
+            }
+
+            parse_context context;
+            context.source = new_source(str);
+            context.source->lazy_numbers = options.lazy_numbers;
+            context.source->lazy_strings = options.lazy_strings;
+            context.lazy_numbers = options.lazy_numbers;
+            context.lazy_strings = options.lazy_strings;
+            // Raw subtrees step over their counts (skip_counts()) to keep the
+            // rest in step
+            count_elements(str.data(), str.length(), 0, context.sizes);
+            try {
+                size_t pos = 0;
+                skip_whitespace(str, pos);
+                if (pos >= str.length()) throw parse_error("empty input");
+                parse_projection(str, pos, tree, 0, result, &context);
+                skip_whitespace(str, pos);
+                if (pos < str.length()) throw parse_error("unexpected data after JSON");
+            }
+            catch (...) {
+                drop_source(context.source);
+                throw;
+            }
+            drop_source(context.source);
+            return result;
+        }
+
+        // Pre-serialized JSON to insert into a document; validated here
+        // (throws parse_error), written verbatim by dump()
+        static json raw_fragment(const std::string& text) {
+            size_t pos = 0;
+            skip_whitespace(text, pos);
+            if (pos >= text.length()) throw parse_error("empty input");
+            size_t start = pos;
+            skip_value(text, pos);
+            size_t end = pos;
+            skip_whitespace(text, pos);
+            if (pos < text.length()) throw parse_error("unexpected data after JSON");
+
+            shared_source* source = new_source(text);
+            json result;
+            try {
+                result.make_raw(source, start, end - start);
+            }
+            catch (...) {
+                drop_source(source);
+                throw;
+            }
+            drop_source(source);
+            return result;
+        }
+
+        // Parse buf in place: escapes are decoded inside the buffer and
+        // string values point into it instead of being copied. buf has to
+        // stay alive and unchanged for as long as the result, or a copy of
+        // any value from it, is in use. Member names are still copied.
+        static json parse_insitu(char* buf, size_t len) {
+            parse_context context;
+            context.source = new_insitu_source(buf);
+            json result;
+            try {
+                size_t pos = 0;
+                skip_whitespace(buf, len, pos);
+                if (pos >= len) throw parse_error("empty input");
+                count_elements(buf, len, pos, context.sizes);
+                json value = insitu_value(buf, len, pos, &context);
+                result.take(value);
+                skip_whitespace(buf, len, pos);
+                if (pos < len) throw parse_error("unexpected data after JSON");
+            }
+            catch (...) {
+                drop_source(context.source);
+                throw;
+            }
+            drop_source(context.source);
+            return result;
+        }
+
+        // Parse only the subtrees named by paths (dotted paths, or JSON
+        // Pointers starting with '/'), with their parent keys, in document
+        // order. Everything else is validated and skipped without being
+        // built. Array elements keep their indices: elements in front of a
+        // selected one are null. "" selects the whole document.
+        static json parse_projected(const std::string& str, const std::vector<std::string>& paths) {
+            std::vector<projection> tree(1);
+            for (size_t i = 0; i < paths.size(); ++i) {
+                add_projection(tree, paths[i]);
+            }
+
+            size_t pos = 0;
+            skip_whitespace(str, pos);
+            if (pos >= str.length()) throw parse_error("empty input");
+            json result;
+            parse_projection(str, pos, tree, 0, result, nullptr);
+            skip_whitespace(str, pos);
+            if (pos < str.length()) throw parse_error("unexpected data after JSON");
             return result;
         }
 
@@ -721,6 +2115,26 @@ namespace tinyjson {
             return written == content.length();
         }
 
+        // Save through a caller-supplied buffer so the content needs no heap
+        // allocation. If the buffer is too small nothing is written and false
+        // is returned; required receives the size needed either way.
+        bool save_to_file(const std::string& filepath, int indent, char* buffer, size_t capacity, size_t& required) const {
+            required = dump_to(buffer, capacity, indent);
+            if (required > capacity) {
+                return false;
+            }
+
+            FILE* file = fopen(filepath.c_str(), "wb");
+            if (!file) {
+                return false;
+            }
+
+            size_t written = fwrite(buffer, 1, required, file);
+            fclose(file);
+
+            return written == required;
+        }
+
         // Save to file with error message
         bool save_to_file_verbose(const std::string& filepath, int indent, std::string& error_msg) const {
             FILE* file = fopen(filepath.c_str(), "wb");
@@ -748,6 +2162,51 @@ namespace tinyjson {
             return true;
         }
 
+        // Scatter-gather output: the serializer produces a list of segments and
+        // hands them to writev() (plain writes where that doesn't exist), so
+        // long strings and fragments kept by dump_incremental() go out
+        // without being copied into one big buffer first. fd may be a file,
+        // pipe or socket and is left open.
+        bool write_gather(int fd, int indent = -1) const {
+            gather_sink out;
+            serialize(out, indent, 0);
+            const std::vector<detail::segment>& segments = out.segments();
+            return segments.empty() || detail::write_segments(fd, &segments[0], segments.size());
+        }
+
+        bool save_to_file_gather(const std::string& filepath, int indent = 2) const {
+            int fd = detail::open_for_writing(filepath);
+            if (fd < 0) {
+                return false;
+            }
+
+            bool written = write_gather(fd, indent);
+            bool closed = detail::close_file(fd);
+            return written && closed;
+        }
+
+        // Save using dump_incremental(): only subtrees modified since the last
+        // incremental save are serialized again. Written like
+        // save_to_file_atomic(), so a crash keeps the previous file.
+        bool save_to_file_incremental(const std::string& filepath, int indent = 2) {
+            std::string content = dump_incremental(indent);
+            std::string error_msg;
+            return detail::write_file_atomic(filepath, content.data(), content.length(), error_msg);
+        }
+
+        // Crash-safe save: write to a temporary file next to filepath, flush
+        // it to disk and rename it over filepath. The previous file stays intact until the
+        // new one is complete.
+        bool save_to_file_atomic(const std::string& filepath, int indent = 2) const {
+            std::string error_msg;
+            return save_to_file_atomic_verbose(filepath, indent, error_msg);
+        }
+
+        bool save_to_file_atomic_verbose(const std::string& filepath, int indent, std::string& error_msg) const {
+            std::string content = dump(indent);
+            return detail::write_file_atomic(filepath, content.data(), content.length(), error_msg);
+        }
+
         // Load from file with error message
         static json load_from_file_verbose(const std::string& filepath, std::string& error_msg) {
             FILE* file = fopen(filepath.c_str(), "rb");
@@ -779,352 +2238,4654 @@ namespace tinyjson {
                 throw parse_error(error_msg);
             }
 
-            try {
-                return parse(content);
-            }
-            catch (const parse_error& e) {
-                error_msg = "Failed to parse JSON: " + std::string(e.what());
-                throw;
+            try {
+                return parse(content);
+            }
+            catch (const parse_error& e) {
+                error_msg = "Failed to parse JSON: " + std::string(e.what());
+                throw;
+            }
+        }
+
+    private:
+        friend class json_path_cache;
+        friend class json_batch;
+        friend class json_serializer;
+        template<typename Sink> friend class json_cbor_writer;
+        friend class json_view;
+        friend class json_snapshot;
+        friend class json_tape;
+        friend class json_lazy;
+
+        // Serialized bytes of a clean subtree, kept by dump_incremental()
+        struct fragment {
+            std::string bytes;
+            int indent;
+            int current_indent;
+            std::vector<unsigned int> generations;   // of the subtree, in document order
+        };
+
+        // Copy of the input that source-backed nodes (raw values, lazy
+        // numbers) point into, shared by all of them
+        struct shared_source {
+            std::string text;
+            const char* data;    // text.data(), or the buffer given to parse_insitu()
+            bool insitu;         // string slices hold decoded bytes, not literals
+            volatile long refs;
+            bool lazy_numbers;   // how raw values are parsed when accessed
+            bool lazy_strings;
+            detail::mutex lock;  // held while a raw value or lazy string is first parsed
+        };
+
+        value_t m_type;
+        unsigned int m_generation;
+        union {
+            bool boolean;
+            long long number_integer;
+            double number_float;
+            struct {
+                unsigned int offset;
+                unsigned int length : 31;
+                unsigned int escaped : 1;   // lazy strings: decoding isn't a plain copy
+            } slice;   // raw, lazy numbers and lazy strings: text in m_source
+        } m_value;
+        union {   // the one m_type uses; null for a lazy string not yet decoded
+            std::string* m_string;
+            std::vector<std::pair<std::string, json>>* m_object;
+            std::vector<json>* m_array;
+        };
+        fragment* m_fragment;
+        shared_source* m_source;
+
+        // Count of every generation bump, for readers that want a fast "nothing
+        // changed" check (json_path_cache, json_serializer). Every document
+        // shares it, so it is only advanced while such a reader exists
+        // (clock_users()); otherwise a bump touches just its own node. It is
+        // 64 bits wide while nodes keep a 32-bit count, so a reader that
+        // remembers the clock can tell when 2^32 bumps have passed and an
+        // equal generation no longer proves anything (see generation_wrapped()).
+        static volatile long long& generation_clock() {
+            static volatile long long clock = 0;
+            return clock;
+        }
+
+        static long long current_clock() {
+            return detail::atomic_read(&generation_clock());
+        }
+
+        static volatile long& clock_users() {
+            static volatile long users = 0;
+            return users;
+        }
+
+        // Member of a reader that relies on the clock: registered for its
+        // lifetime (copies included), so every bump it could have missed
+        // advances the clock
+        struct clock_user {
+            clock_user() { detail::atomic_increment(&clock_users()); }
+            clock_user(const clock_user&) { detail::atomic_increment(&clock_users()); }
+            ~clock_user() { detail::atomic_decrement(&clock_users()); }
+            clock_user& operator=(const clock_user&) { return *this; }
+        };
+
+        static bool generation_wrapped(long long since, long long now) {
+            return now - since >= 0x100000000LL;
+        }
+
+        void bump_generation() {
+            ++m_generation;
+            if (detail::load_acquire(&clock_users()) != 0) detail::atomic_increment(&generation_clock());
+        }
+
+        // Called by every accessor that hands out mutable access: whatever was
+        // cached for this subtree can no longer be trusted
+        void touch() {
+            resolve();
+            if (m_fragment) drop_fragment();
+        }
+
+        // Raw nodes are parsed in place the first time anything looks inside.
+        // Const readers on several threads may get there together: the first
+        // parses under the source's lock and the others find the result.
+        void resolve() const {
+            if (load_type() == raw) const_cast<json*>(this)->parse_raw();
+        }
+
+        // m_type as published by parse_raw() on another thread
+        value_t load_type() const {
+            return static_cast<value_t>(detail::load_acquire(reinterpret_cast<const volatile int*>(&m_type)));
+        }
+
+        // Keeps m_source, which readers use to find the lock: a number or
+        // string stays a slice of it, anything else just holds the reference
+        void parse_raw() {
+            detail::lock_guard guard(m_source->lock);
+            if (m_type != raw) return;
+
+            size_t pos = m_value.slice.offset;
+            char first = m_source->text[pos];
+            bool scalar = first != '{' && first != '[';
+            parse_context context;
+            context.source = m_source;
+            context.lazy_numbers = scalar || m_source->lazy_numbers;
+            context.lazy_strings = scalar || m_source->lazy_strings;
+            if (!scalar) count_elements(m_source->text.data(), m_source->text.length(), pos, context.sizes);
+            json value = parse_value(m_source->text, pos, &context);
+
+            m_value = value.m_value;
+            value_t type = value.m_type;
+            take_storage(value, type);
+            if (value.m_source) drop_source(value.m_source);
+            value.m_type = null;
+            value.m_source = nullptr;
+            detail::store_release(reinterpret_cast<volatile int*>(&m_type), static_cast<int>(type));
+        }
+
+        static shared_source* new_source(const std::string& text) {
+            shared_source* source = new shared_source();
+            source->text = text;
+            source->data = source->text.data();
+            source->insitu = false;
+            source->refs = 1;
+            source->lazy_numbers = false;
+            source->lazy_strings = false;
+            return source;
+        }
+
+        static shared_source* new_insitu_source(const char* buffer) {
+            shared_source* source = new shared_source();
+            source->data = buffer;
+            source->insitu = true;
+            source->refs = 1;
+            source->lazy_numbers = false;
+            source->lazy_strings = false;
+            return source;
+        }
+
+        static void drop_source(shared_source* source) {
+            if (detail::atomic_decrement(&source->refs) == 0) delete source;
+        }
+
+        // Point this node at source text [offset, offset + length): a raw
+        // value, a number kept as its digits or the inside of a string
+        // literal (m_type says which)
+        void make_source_slice(shared_source* source, size_t offset, size_t length) {
+            if (offset + length > 0xFFFFFFFFu) throw parse_error("source-backed value beyond 4 GB of input");
+            if (length > 0x7FFFFFFFu) throw parse_error("source-backed value longer than 2 GB");
+            detail::atomic_increment(&source->refs);
+            m_source = source;
+            m_value.slice.offset = static_cast<unsigned int>(offset);
+            m_value.slice.length = static_cast<unsigned int>(length);
+            m_value.slice.escaped = 0;
+        }
+
+        void make_raw(shared_source* source, size_t offset, size_t length) {
+            make_source_slice(source, offset, length);
+            m_type = raw;
+        }
+
+        const char* source_text() const {
+            return m_source->data + m_value.slice.offset;
+        }
+
+        // Number values, converted from the source digits when there are any
+        long long integer_value() const {
+            if (!m_source) return m_value.number_integer;
+            long long integer;
+            double floating;
+            size_t pos = m_value.slice.offset;
+            read_number(m_source->text, pos, integer, floating);
+            return integer;
+        }
+
+        double float_value() const {
+            if (!m_source) return m_value.number_float;
+            long long integer;
+            double floating;
+            size_t pos = m_value.slice.offset;
+            read_number(m_source->text, pos, integer, floating);
+            return floating;
+        }
+
+        // String value; a lazy string is decoded into m_string the first
+        // time it is needed and the result kept. Decoding takes the source's
+        // lock like parse_raw(), so const readers can share the document.
+        const std::string& string_value() const {
+            std::string* decoded = load_string();
+            if (!decoded) decoded = const_cast<json*>(this)->decode_string();
+            return *decoded;
+        }
+
+        std::string* load_string() const {
+            return detail::load_acquire(&m_string);
+        }
+
+        std::string* decode_string() {
+            detail::lock_guard guard(m_source->lock);
+            if (m_string) return m_string;
+
+            std::string* decoded = new std::string();
+            if (m_value.slice.escaped) {
+                size_t pos = m_value.slice.offset - 1;   // opening quote
+                read_string(m_source->text, pos, *decoded);
+            }
+            else {
+                decoded->assign(source_text(), m_value.slice.length);
+            }
+            detail::store_release(&m_string, decoded);
+            return decoded;
+        }
+
+        // Decoded bytes and length, read straight from the source when the
+        // literal has no escapes
+        const char* string_data() const {
+            if (!m_value.slice.escaped && !load_string()) return source_text();
+            return string_value().data();
+        }
+
+        size_t string_length() const {
+            if (!m_value.slice.escaped && !load_string()) return m_value.slice.length;
+            return string_value().length();
+        }
+
+        void drop_fragment() {
+            delete m_fragment;
+            m_fragment = nullptr;
+        }
+
+        // Free owned storage and reset to null (clear() without the generation bump)
+        void release() {
+            if (m_fragment) drop_fragment();
+            if (m_source) {
+                drop_source(m_source);
+                m_source = nullptr;
+            }
+            if (m_type == string) delete m_string;
+            else if (m_type == object) delete m_object;
+            else if (m_type == array) delete m_array;
+            m_string = nullptr;
+            m_type = null;
+            m_value.number_integer = 0;
+        }
+
+        // Move other's contents here without copying; other becomes null
+        void take(json& other) {
+            release();
+            m_type = other.m_type;
+            m_value = other.m_value;
+            take_storage(other, m_type);
+            m_source = other.m_source;
+            other.m_type = null;
+            other.m_source = nullptr;
+            other.drop_fragment();
+        }
+
+        void copy_from(const json& other) {
+            m_value = other.m_value;
+            if (other.m_source) {
+                detail::atomic_increment(&other.m_source->refs);
+                m_source = other.m_source;
+            }
+            if (m_type == string) {
+                std::string* other_string = other.load_string();
+                if (other_string) m_string = new std::string(*other_string);
+            }
+            else if (m_type == object) {
+                m_object = new std::vector<std::pair<std::string, json>>(*other.m_object);
+            }
+            else if (m_type == array) {
+                m_array = new std::vector<json>(*other.m_array);
+            }
+        }
+
+        // Move the string, object or array pointer that type uses from other
+        void take_storage(json& other, value_t type) {
+            if (type == string) m_string = other.m_string;
+            else if (type == object) m_object = other.m_object;
+            else if (type == array) m_array = other.m_array;
+            other.m_string = nullptr;
+        }
+
+        // Walk the first `depth` tokens of a pointer without allocating
+        const json* resolve_pointer(const json_pointer& ptr, size_t depth) const {
+            const json* current = this;
+            for (size_t i = 0; i < depth; ++i) {
+                current->resolve();
+                if (current->m_type == object) {
+                    const std::string& key = ptr.token(i);
+                    const json* next = nullptr;
+                    for (size_t j = 0; j < current->m_object->size(); ++j) {
+                        if ((*current->m_object)[j].first == key) {
+                            next = &(*current->m_object)[j].second;
+                            break;
+                        }
+                    }
+                    if (!next) return nullptr;
+                    current = next;
+                }
+                else if (current->m_type == array) {
+                    size_t index = ptr.index(i);
+                    if (index >= current->m_array->size()) return nullptr;
+                    current = &(*current->m_array)[index];
+                }
+                else {
+                    return nullptr;
+                }
+            }
+            return current;
+        }
+
+        // Mutable walk: everything on the way may be modified through the result
+        json* resolve_pointer(const json_pointer& ptr, size_t depth) {
+            const json* target = static_cast<const json*>(this)->resolve_pointer(ptr, depth);
+            if (!target) return nullptr;
+
+            json* current = this;
+            for (size_t i = 0; i < depth; ++i) {
+                current->touch();
+                if (current->m_type == object) {
+                    for (size_t j = 0; j < current->m_object->size(); ++j) {
+                        if ((*current->m_object)[j].first == ptr.token(i)) {
+                            current = &(*current->m_object)[j].second;
+                            break;
+                        }
+                    }
+                }
+                else {
+                    current = &(*current->m_array)[ptr.index(i)];
+                }
+            }
+            return current;
+        }
+
+        // Helper for value() method with type checking
+        template<typename T>
+        static T get_value_helper(const json& j, const T& default_val) {
+            return default_val;  // Generic fallback
+        }
+
+        // Helper to split path by dots
+        static std::vector<std::string> split_path(const std::string& path) {
+            std::vector<std::string> parts;
+            std::string current;
+
+            for (size_t i = 0; i < path.length(); ++i) {
+                if (path[i] == '.') {
+                    if (!current.empty()) {
+                        parts.push_back(current);
+                        current.clear();
+                    }
+                }
+                else {
+                    current += path[i];
+                }
+            }
+
+            if (!current.empty()) {
+                parts.push_back(current);
+            }
+
+            return parts;
+        }
+
+        // Xbox 360 compatible number to string conversion
+        static std::string int_to_string(long long value) {
+            char buffer[24];
+            return std::string(buffer, format_int(buffer, value));
+        }
+
+        static std::string size_to_string(size_t value) {
+            char buffer[24];
+            return std::string(buffer, format_uint(buffer, value));
+        }
+
+        // "00" "01" ... "99"
+        static const char* digit_pairs() {
+            static const char pairs[201] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+            return pairs;
+        }
+
+        static int count_digits(unsigned long long value) {
+            int digits = 1;
+            for (;;) {
+                if (value < 10) return digits;
+                if (value < 100) return digits + 1;
+                if (value < 1000) return digits + 2;
+                if (value < 10000) return digits + 3;
+                value /= 10000;
+                digits += 4;
+            }
+        }
+
+        // Write value into buffer (at least 20 bytes, not terminated), return length
+        static size_t format_uint(char* buffer, unsigned long long value) {
+            const char* pairs = digit_pairs();
+            int length = count_digits(value);
+            char* p = buffer + length;
+            while (value >= 100) {
+                unsigned int i = static_cast<unsigned int>(value % 100) * 2;
+                value /= 100;
+                *--p = pairs[i + 1];
+                *--p = pairs[i];
+            }
+            if (value >= 10) {
+                unsigned int i = static_cast<unsigned int>(value) * 2;
+                *--p = pairs[i + 1];
+                *--p = pairs[i];
+            }
+            else {
+                *--p = static_cast<char>('0' + value);
+            }
+            return static_cast<size_t>(length);
+        }
+
+        // Write value into buffer (at least 21 bytes, not terminated), return length
+        static size_t format_int(char* buffer, long long value) {
+            if (value < 0) {
+                *buffer = '-';
+                // Negate in unsigned arithmetic so LLONG_MIN doesn't overflow
+                return 1 + format_uint(buffer + 1, 0ULL - static_cast<unsigned long long>(value));
+            }
+            return format_uint(buffer, static_cast<unsigned long long>(value));
+        }
+
+        template<typename Sink>
+        static void write_int(Sink& out, long long value) {
+            char buffer[24];
+            out.append(buffer, format_int(buffer, value));
+        }
+
+        // Check if string is numeric (for array indices)
+        static bool is_numeric(const std::string& str) {
+            if (str.empty()) return false;
+            for (size_t i = 0; i < str.length(); ++i) {
+                if (str[i] < '0' || str[i] > '9') return false;
+            }
+            return true;
+        }
+
+        // Convert string to size_t
+        static size_t string_to_size_t(const std::string& str) {
+            size_t result = 0;
+            for (size_t i = 0; i < str.length(); ++i) {
+                result = result * 10 + (str[i] - '0');
+            }
+            return result;
+        }
+
+        // Output targets for serialize(). All three see exactly the same calls,
+        // so size_sink's count is the exact length the other two will write.
+        struct string_sink {
+            std::string& str;
+            explicit string_sink(std::string& s) : str(s) {}
+            void append(const char* data, size_t length) { str.append(data, length); }
+            void put(char c) { str += c; }
+            void fill(size_t count, char c) { str.append(count, c); }
+        };
+
+        // string_sink for serialize_incremental(): children go through
+        // serialize_incremental() too, so their fragments are used and kept
+        struct fragment_sink : string_sink {
+            explicit fragment_sink(std::string& s) : string_sink(s) {}
+        };
+
+        // Unchecked writes into memory already sized with size_sink
+        struct buffer_sink {
+            char* pos;
+            explicit buffer_sink(char* buffer) : pos(buffer) {}
+            void append(const char* data, size_t length) { memcpy(pos, data, length); pos += length; }
+            void put(char c) { *pos++ = c; }
+            void fill(size_t count, char c) { memset(pos, c, count); pos += count; }
+        };
+
+        struct size_sink {
+            size_t size;
+            size_sink() : size(0) {}
+            void append(const char*, size_t length) { size += length; }
+            void put(char) { ++size; }
+            void fill(size_t count, char) { size += count; }
+        };
+
+        // Output kept as a list of segments for write_gather(). Generated text
+        // goes into fixed-size blocks that never move; long string runs and
+        // serialization fragments are referenced where they already live.
+        class gather_sink {
+        public:
+            enum {
+                block_size = 64 * 1024,
+                reference_min = 512   // shorter runs are cheaper to copy
+            };
+
+            gather_sink() : m_block(nullptr), m_used(block_size) {}
+
+            ~gather_sink() {
+                for (size_t i = 0; i < m_blocks.size(); ++i) {
+                    delete[] m_blocks[i];
+                }
+            }
+
+            void append(const char* data, size_t length) {
+                while (length > 0) {
+                    size_t step = reserve(length);
+                    memcpy(m_block + m_used, data, step);
+                    commit(step);
+                    data += step;
+                    length -= step;
+                }
+            }
+
+            void put(char c) {
+                reserve(1);
+                m_block[m_used] = c;
+                commit(1);
+            }
+
+            void fill(size_t count, char c) {
+                while (count > 0) {
+                    size_t step = reserve(count);
+                    memset(m_block + m_used, c, step);
+                    commit(step);
+                    count -= step;
+                }
+            }
+
+            // Bytes that stay valid until the segments have been written
+            void reference(const char* data, size_t length) {
+                if (length < reference_min) {
+                    append(data, length);
+                    return;
+                }
+                detail::segment piece = { data, length };
+                m_segments.push_back(piece);
+            }
+
+            const std::vector<detail::segment>& segments() const { return m_segments; }
+
+        private:
+            std::vector<detail::segment> m_segments;
+            std::vector<char*> m_blocks;
+            char* m_block;
+            size_t m_used;
+
+            // Room for up to length bytes in the current block
+            size_t reserve(size_t length) {
+                if (m_used == block_size) {
+                    m_block = new char[block_size];
+                    m_blocks.push_back(m_block);
+                    m_used = 0;
+                }
+                size_t room = block_size - m_used;
+                return length < room ? length : room;
+            }
+
+            // Extend the last segment when it ends where the new bytes start
+            void commit(size_t length) {
+                char* start = m_block + m_used;
+                if (m_segments.empty() || m_segments.back().data + m_segments.back().length != start) {
+                    detail::segment piece = { start, 0 };
+                    m_segments.push_back(piece);
+                }
+                m_segments.back().length += length;
+                m_used += length;
+            }
+
+            gather_sink(const gather_sink&);
+            gather_sink& operator=(const gather_sink&);
+        };
+
+        // Bytes of the document itself (string contents, fragments): copied by
+        // the memory sinks, referenced in place by gather_sink
+        template<typename Sink>
+        static void append_stable(Sink& out, const char* data, size_t length) {
+            out.append(data, length);
+        }
+
+        static void append_stable(gather_sink& out, const char* data, size_t length) {
+            out.reference(data, length);
+        }
+
+        // Only write_gather() reuses fragments left by dump_incremental(); the
+        // other outputs never depend on them
+        template<typename Sink>
+        bool append_fragment(Sink&, int, int) const {
+            return false;
+        }
+
+        bool append_fragment(gather_sink& out, int indent, int current_indent) const {
+            if (!fragment_usable(indent, current_indent)) return false;
+            out.reference(m_fragment->bytes.data(), m_fragment->bytes.length());
+            return true;
+        }
+
+        // The fragment was written with this layout and nothing under this
+        // node has changed since. A fragment covers at most fragment_max_size
+        // bytes of output, which bounds the walk.
+        bool fragment_usable(int indent, int current_indent) const {
+            if (!m_fragment || m_fragment->indent != indent || m_fragment->current_indent != current_indent) {
+                return false;
+            }
+            size_t next = 0;
+            return generations_match(m_fragment->generations, next) && next == m_fragment->generations.size();
+        }
+
+        void record_generations(std::vector<unsigned int>& out) const {
+            out.push_back(m_generation);
+            if (m_type == array) {
+                for (size_t i = 0; i < m_array->size(); ++i) {
+                    (*m_array)[i].record_generations(out);
+                }
+            }
+            else if (m_type == object) {
+                for (size_t i = 0; i < m_object->size(); ++i) {
+                    (*m_object)[i].second.record_generations(out);
+                }
+            }
+        }
+
+        // Parents come before their children, so a container whose children
+        // were replaced or moved fails before they are looked at
+        bool generations_match(const std::vector<unsigned int>& recorded, size_t& next) const {
+            if (next >= recorded.size() || recorded[next] != m_generation) return false;
+            ++next;
+            if (m_type == array) {
+                for (size_t i = 0; i < m_array->size(); ++i) {
+                    if (!(*m_array)[i].generations_match(recorded, next)) return false;
+                }
+            }
+            else if (m_type == object) {
+                for (size_t i = 0; i < m_object->size(); ++i) {
+                    if (!(*m_object)[i].second.generations_match(recorded, next)) return false;
+                }
+            }
+            return true;
+        }
+
+        template<typename Sink>
+        static void write_float(Sink& out, double value) {
+            char buffer[64];
+            int length = sprintf(buffer, "%.17g", value);
+            out.append(buffer, static_cast<size_t>(length));
+        }
+
+        // Write the serialized value to a sink (string_sink, buffer_sink,
+        // size_sink or gather_sink)
+        template<typename Sink>
+        void serialize(Sink& out, int indent, int current_indent) const {
+            if (m_fragment && append_fragment(out, indent, current_indent)) return;
+
+            switch (load_type()) {
+            case null:
+                out.append("null", 4);
+                break;
+            case boolean:
+                if (m_value.boolean) out.append("true", 4);
+                else out.append("false", 5);
+                break;
+            case number_integer:
+                if (m_source) append_stable(out, source_text(), m_value.slice.length);
+                else write_int(out, m_value.number_integer);
+                break;
+            case number_float:
+                if (m_source) append_stable(out, source_text(), m_value.slice.length);
+                else write_float(out, m_value.number_float);
+                break;
+            case raw:
+                serialize_raw(out, indent, current_indent);
+                break;
+            case string:
+                out.put('"');
+                if (m_source && !m_source->insitu) append_stable(out, source_text(), m_value.slice.length);
+                else write_escaped(out, string_data(), string_length());
+                out.put('"');
+                break;
+            case array:
+                out.put('[');
+                if (indent >= 0 && !m_array->empty()) {
+                    out.put('\n');
+                }
+                serialize_children(out, 0, m_array->size(), indent, current_indent);
+                if (indent >= 0 && !m_array->empty()) {
+                    out.fill(current_indent, ' ');
+                }
+                out.put(']');
+                break;
+            case object:
+                out.put('{');
+                if (indent >= 0 && !m_object->empty()) {
+                    out.put('\n');
+                }
+                serialize_children(out, 0, m_object->size(), indent, current_indent);
+                if (indent >= 0 && !m_object->empty()) {
+                    out.fill(current_indent, ' ');
+                }
+                out.put('}');
+                break;
+            }
+        }
+
+        // Raw text as received, or laid out like the rest of the output when
+        // indenting. Holds the source's lock so another thread's parse_raw()
+        // can't rewrite the node in the middle.
+        template<typename Sink>
+        void serialize_raw(Sink& out, int indent, int current_indent) const {
+            {
+                detail::lock_guard guard(m_source->lock);
+                if (m_type == raw) {
+                    if (indent < 0) append_stable(out, source_text(), m_value.slice.length);
+                    else write_reindented(out, source_text(), m_value.slice.length, indent, current_indent);
+                    return;
+                }
+            }
+            serialize(out, indent, current_indent);   // parsed in the meantime
+        }
+
+        // Validated JSON text with its whitespace replaced by dump(indent)'s.
+        // String literals and numbers are copied unchanged.
+        template<typename Sink>
+        static void write_reindented(Sink& out, const char* text, size_t length, int indent, int current_indent) {
+            size_t step = static_cast<size_t>(indent);
+            size_t level = static_cast<size_t>(current_indent);
+            size_t i = 0;
+            while (i < length) {
+                char c = text[i];
+                if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                    ++i;
+                }
+                else if (c == '"') {
+                    size_t start = i++;
+                    while (text[i] != '"') i += text[i] == '\\' ? 2 : 1;
+                    ++i;
+                    out.append(text + start, i - start);
+                }
+                else if (c == '{' || c == '[') {
+                    size_t next = i + 1;
+                    while (text[next] == ' ' || text[next] == '\t' || text[next] == '\n' || text[next] == '\r') ++next;
+                    out.put(c);
+                    if (text[next] == '}' || text[next] == ']') {
+                        out.put(text[next]);
+                        i = next + 1;
+                    }
+                    else {
+                        level += step;
+                        out.put('\n');
+                        out.fill(level, ' ');
+                        i = next;
+                    }
+                }
+                else if (c == '}' || c == ']') {
+                    level -= step;
+                    out.put('\n');
+                    out.fill(level, ' ');
+                    out.put(c);
+                    ++i;
+                }
+                else if (c == ',') {
+                    out.append(",\n", 2);
+                    out.fill(level, ' ');
+                    ++i;
+                }
+                else if (c == ':') {
+                    out.append(": ", 2);
+                    ++i;
+                }
+                else {
+                    size_t start = i;
+                    while (i < length && text[i] != ',' && text[i] != '}' && text[i] != ']' &&
+                        text[i] != ' ' && text[i] != '\t' && text[i] != '\n' && text[i] != '\r') ++i;
+                    out.append(text + start, i - start);
+                }
+            }
+        }
+
+        // Children [lo, hi) of a container as they appear between its brackets
+        // (indentation, keys, separators); current_indent is the container's
+        template<typename Sink>
+        void serialize_children(Sink& out, size_t lo, size_t hi, int indent, int current_indent) const {
+            size_t count = m_type == array ? m_array->size() : m_object->size();
+            for (size_t i = lo; i < hi; ++i) {
+                if (indent >= 0) {
+                    out.fill(current_indent + indent, ' ');
+                }
+                if (m_type == array) {
+                    serialize_element(out, (*m_array)[i], indent, current_indent + indent);
+                }
+                else {
+                    const std::string& key = (*m_object)[i].first;
+                    out.put('"');
+                    write_escaped(out, key.data(), key.length());
+                    out.append("\":", 2);
+                    if (indent >= 0) {
+                        out.put(' ');
+                    }
+                    serialize_element(out, (*m_object)[i].second, indent, current_indent + indent);
+                }
+                if (i < count - 1) {
+                    out.put(',');
+                }
+                if (indent >= 0) {
+                    out.put('\n');
+                }
+            }
+        }
+
+        template<typename Sink>
+        static void serialize_element(Sink& out, const json& value, int indent, int current_indent) {
+            value.serialize(out, indent, current_indent);
+        }
+
+        // dump_incremental() writes the children through their own fragments.
+        // It only runs on a non-const document, so the children aren't const.
+        static void serialize_element(fragment_sink& out, const json& value, int indent, int current_indent) {
+            const_cast<json&>(value).serialize_incremental(out.str, indent, current_indent);
+        }
+
+#ifndef TINYJSON_NO_THREADS
+        // Containers with fewer elements than this are never split, and no run
+        // handed to a thread is shorter. dump_parallel() looks this many levels
+        // deep for large containers (e.g. {"items": [...]}).
+        enum {
+            parallel_min_run = 256,
+            parallel_plan_depth = 3
+        };
+
+        // Part of the dump_parallel() output: literal text when node is null,
+        // otherwise children [lo, hi) of node, filled in by a worker
+        struct parallel_piece {
+            std::string text;
+            const json* node;
+            size_t lo;
+            size_t hi;
+            int indent;
+            int current_indent;
+
+            parallel_piece() : node(nullptr), lo(0), hi(0), indent(-1), current_indent(0) {}
+        };
+
+        struct parallel_job {
+            std::vector<parallel_piece> pieces;
+            std::vector<size_t> tasks;   // indices of the pieces left to workers
+            size_t next;
+            detail::mutex lock;
+
+            parallel_job() : next(0) {}
+        };
+
+        static void parallel_worker(void* arg) {
+            parallel_job* job = static_cast<parallel_job*>(arg);
+            for (;;) {
+                size_t task;
+                {
+                    detail::lock_guard guard(job->lock);
+                    if (job->next >= job->tasks.size()) return;
+                    task = job->tasks[job->next++];
+                }
+                parallel_piece& piece = job->pieces[task];
+                string_sink out(piece.text);
+                piece.node->serialize_children(out, piece.lo, piece.hi, piece.indent, piece.current_indent);
+            }
+        }
+
+        // Text that goes to the output as is (merged with a preceding literal)
+        static std::string& literal_piece(std::vector<parallel_piece>& pieces) {
+            if (pieces.empty() || pieces.back().node) pieces.push_back(parallel_piece());
+            return pieces.back().text;
+        }
+
+        // Cut the output into literal text and runs of container elements
+        void plan_parallel(std::vector<parallel_piece>& pieces, int indent, int current_indent,
+            unsigned int threads, int depth) const {
+            size_t count = 0;
+            if (m_type == array) count = m_array->size();
+            else if (m_type == object) count = m_object->size();
+
+            if (count == 0) {
+                string_sink out(literal_piece(pieces));
+                serialize(out, indent, current_indent);
+                return;
+            }
+
+            std::string& open = literal_piece(pieces);
+            open += m_type == array ? '[' : '{';
+            if (indent >= 0) open += '\n';
+
+            if (count >= 2 * parallel_min_run) {
+                // A few runs per thread so uneven elements still balance out
+                size_t run = count / (threads * 4);
+                if (run < parallel_min_run) run = parallel_min_run;
+                for (size_t lo = 0; lo < count; lo += run) {
+                    parallel_piece piece;
+                    piece.node = this;
+                    piece.lo = lo;
+                    piece.hi = lo + run < count ? lo + run : count;
+                    piece.indent = indent;
+                    piece.current_indent = current_indent;
+                    pieces.push_back(piece);
+                }
+            }
+            else if (depth < parallel_plan_depth) {
+                for (size_t i = 0; i < count; ++i) {
+                    std::string& prefix = literal_piece(pieces);
+                    string_sink out(prefix);
+                    if (indent >= 0) {
+                        out.fill(current_indent + indent, ' ');
+                    }
+                    const json* child;
+                    if (m_type == array) {
+                        child = &(*m_array)[i];
+                    }
+                    else {
+                        const std::string& key = (*m_object)[i].first;
+                        out.put('"');
+                        write_escaped(out, key.data(), key.length());
+                        out.append("\":", 2);
+                        if (indent >= 0) {
+                            out.put(' ');
+                        }
+                        child = &(*m_object)[i].second;
+                    }
+                    child->plan_parallel(pieces, indent, current_indent + indent, threads, depth + 1);
+
+                    std::string& suffix = literal_piece(pieces);
+                    if (i < count - 1) suffix += ',';
+                    if (indent >= 0) suffix += '\n';
+                }
+            }
+            else {
+                parallel_piece piece;
+                piece.node = this;
+                piece.hi = count;
+                piece.indent = indent;
+                piece.current_indent = current_indent;
+                pieces.push_back(piece);
+            }
+
+            std::string& close = literal_piece(pieces);
+            if (indent >= 0) close.append(current_indent, ' ');
+            close += m_type == array ? ']' : '}';
+        }
+#endif
+
+        // Largest container output kept as one fragment. Bigger containers are
+        // rebuilt from their children's fragments, which bounds the work a
+        // single modification costs.
+        enum { fragment_max_size = 64 * 1024 };
+
+        // serialize() for dump_incremental(): clean subtrees are copied from
+        // their fragment and every container up to fragment_max_size gets a new
+        // one. A fragment covers the whole subtree, so the children's are
+        // dropped and each byte is stored once.
+        void serialize_incremental(std::string& out, int indent, int current_indent) {
+            if (m_fragment) {
+                if (fragment_usable(indent, current_indent)) {
+                    out.append(m_fragment->bytes);
+                    return;
+                }
+                drop_fragment();
+            }
+
+            size_t start = out.length();
+            fragment_sink sink(out);
+            serialize(sink, indent, current_indent);
+            if (m_type != array && m_type != object) return;
+
+            size_t length = out.length() - start;
+            if (length > fragment_max_size) return;
+
+            m_fragment = new fragment();
+            m_fragment->bytes.assign(out, start, length);
+            m_fragment->indent = indent;
+            m_fragment->current_indent = current_indent;
+
+            if (m_type == array) {
+                for (size_t i = 0; i < m_array->size(); ++i) {
+                    (*m_array)[i].touch();
+                }
+            }
+            else {
+                for (size_t i = 0; i < m_object->size(); ++i) {
+                    (*m_object)[i].second.touch();
+                }
+            }
+            record_generations(m_fragment->generations);
+        }
+
+        // Escape sequence for each byte: 0 = copy as is, 'u' = \u00XX,
+        // anything else is the character that follows the backslash
+        static const char* escape_table() {
+            static const char table[256] = {
+                'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+                'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+                0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0
+                // 0x60-0xFF: copied as is (UTF-8 passes through untouched)
+            };
+            return table;
+        }
+
+        // Length of the run of bytes starting at data that need no escaping
+        static size_t clean_run(const char* data, size_t length) {
+            size_t i = 0;
+#if TINYJSON_SSE2
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i control = _mm_set1_epi8(0x1F);
+            for (; i + 16 <= length; i += 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                __m128i special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                    _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+                int mask = _mm_movemask_epi8(special);
+                if (mask != 0) {
+                    while (!(mask & 1)) {
+                        mask >>= 1;
+                        ++i;
+                    }
+                    return i;
+                }
+            }
+#else
+            // SWAR: test eight bytes per step for '"', '\\' or a control character
+            const unsigned long long ones = 0x0101010101010101ULL;
+            const unsigned long long highs = 0x8080808080808080ULL;
+            for (; i + 8 <= length; i += 8) {
+                unsigned long long word;
+                memcpy(&word, data + i, 8);
+                unsigned long long q = word ^ (ones * '"');
+                unsigned long long b = word ^ (ones * '\\');
+                unsigned long long special = ((q - ones) & ~q) | ((b - ones) & ~b) | ((word - ones * 0x20) & ~word);
+                if (special & highs) break;
+            }
+#endif
+            const char* table = escape_table();
+            while (i < length && !table[static_cast<unsigned char>(data[i])]) ++i;
+            return i;
+        }
+
+        // Append data to out with JSON escaping; clean runs are copied in bulk
+        template<typename Sink>
+        static void write_escaped(Sink& out, const char* data, size_t length) {
+            static const char hex[] = "0123456789abcdef";
+            const char* table = escape_table();
+            size_t pos = 0;
+            while (pos < length) {
+                size_t run = clean_run(data + pos, length - pos);
+                if (run > 0) {
+                    append_stable(out, data + pos, run);
+                    pos += run;
+                    if (pos >= length) break;
+                }
+
+                unsigned char c = static_cast<unsigned char>(data[pos++]);
+                char seq[6] = { '\\', table[c], '0', '0', 0, 0 };
+                if (seq[1] == 'u') {
+                    seq[4] = hex[c >> 4];
+                    seq[5] = hex[c & 0x0F];
+                    out.append(seq, 6);
+                }
+                else {
+                    out.append(seq, 2);
+                }
+            }
+        }
+
+        static void put_u32(char* out, unsigned int value) {
+            memcpy(out, &value, 4);
+        }
+
+        static unsigned int snapshot_u32(size_t value) {
+            if (value > 0xFFFFFFFFu) throw parse_error("document too large for a snapshot");
+            return static_cast<unsigned int>(value);
+        }
+
+        static unsigned int snapshot_string(std::string& strings, const char* data, size_t length) {
+            unsigned int offset = snapshot_u32(strings.size());
+            strings.append(data, length);
+            strings += '\0';
+            return offset;
+        }
+
+        struct member_less {
+            const std::vector<std::pair<std::string, json>>* members;
+            explicit member_less(const std::vector<std::pair<std::string, json>>& m) : members(&m) {}
+            bool operator()(unsigned int a, unsigned int b) const {
+                return (*members)[a].first < (*members)[b].first;
+            }
+        };
+
+        // Marker byte followed by the low `bytes` bytes of value, big-endian
+        template<typename Sink>
+        static void write_be(Sink& out, unsigned char marker, unsigned long long value, int bytes) {
+            char buffer[9];
+            buffer[0] = static_cast<char>(marker);
+            for (int i = bytes; i > 0; --i) {
+                buffer[i] = static_cast<char>(value & 0xFF);
+                value >>= 8;
+            }
+            out.append(buffer, static_cast<size_t>(bytes) + 1);
+        }
+
+        // Length for a MessagePack str32/array32/map32 header, which has
+        // only 4 bytes for it
+        static unsigned long long msgpack_u32(size_t value) {
+            if (value > 0xFFFFFFFFu) throw parse_error("string or container too large for MessagePack");
+            return value;
+        }
+
+        static unsigned long long read_be(const unsigned char* data, size_t length, size_t& pos, int bytes) {
+            if (length - pos < static_cast<size_t>(bytes)) throw parse_error("unexpected end of binary data");
+            unsigned long long value = 0;
+            for (int i = 0; i < bytes; ++i) {
+                value = (value << 8) | data[pos++];
+            }
+            return value;
+        }
+
+        static double bits_to_double(unsigned long long bits) {
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        static double bits_to_float(unsigned long long bits) {
+            unsigned int narrow = static_cast<unsigned int>(bits);
+            float value;
+            memcpy(&value, &narrow, sizeof(value));
+            return value;
+        }
+
+        // Decoders write scalars straight into a fresh (null) node
+        static void set_boolean(json& target, bool value) {
+            target.m_type = boolean;
+            target.m_value.boolean = value;
+        }
+
+        static void set_integer(json& target, long long value) {
+            target.m_type = number_integer;
+            target.m_value.number_integer = value;
+        }
+
+        static void set_float(json& target, double value) {
+            target.m_type = number_float;
+            target.m_value.number_float = value;
+        }
+
+        // Containers are filled in place (no copies of decoded subtrees); a
+        // count larger than the remaining input is rejected before reserving
+        static void read_msgpack(json& target, const unsigned char* data, size_t length, size_t& pos) {
+            if (pos >= length) throw parse_error("unexpected end of MessagePack data");
+            unsigned char marker = data[pos++];
+
+            size_t count = 0;
+            if (marker <= 0x7f) {
+                set_integer(target, static_cast<long long>(marker));
+                return;
+            }
+            if (marker >= 0xe0) {
+                set_integer(target, static_cast<long long>(static_cast<signed char>(marker)));
+                return;
+            }
+            if ((marker & 0xe0) == 0xa0) {
+                read_msgpack_string(target, data, length, pos, marker & 0x1f);
+                return;
+            }
+            if ((marker & 0xf0) == 0x90 || (marker & 0xf0) == 0x80) {
+                count = marker & 0x0f;
+            }
+            else switch (marker) {
+            case 0xc0: return;
+            case 0xc2: set_boolean(target, false); return;
+            case 0xc3: set_boolean(target, true); return;
+            case 0xc4: case 0xd9:
+                read_msgpack_string(target, data, length, pos, static_cast<size_t>(read_be(data, length, pos, 1)));
+                return;
+            case 0xc5: case 0xda:
+                read_msgpack_string(target, data, length, pos, static_cast<size_t>(read_be(data, length, pos, 2)));
+                return;
+            case 0xc6: case 0xdb:
+                read_msgpack_string(target, data, length, pos, static_cast<size_t>(read_be(data, length, pos, 4)));
+                return;
+            case 0xca: set_float(target, bits_to_float(read_be(data, length, pos, 4))); return;
+            case 0xcb: set_float(target, bits_to_double(read_be(data, length, pos, 8))); return;
+            case 0xcc: set_integer(target, static_cast<long long>(read_be(data, length, pos, 1))); return;
+            case 0xcd: set_integer(target, static_cast<long long>(read_be(data, length, pos, 2))); return;
+            case 0xce: set_integer(target, static_cast<long long>(read_be(data, length, pos, 4))); return;
+            case 0xcf: {
+                unsigned long long value = read_be(data, length, pos, 8);
+                if (value > 0x7FFFFFFFFFFFFFFFULL) set_float(target, static_cast<double>(value));
+                else set_integer(target, static_cast<long long>(value));
+                return;
+            }
+            case 0xd0: set_integer(target, static_cast<long long>(static_cast<signed char>(read_be(data, length, pos, 1)))); return;
+            case 0xd1: set_integer(target, static_cast<long long>(static_cast<short>(read_be(data, length, pos, 2)))); return;
+            case 0xd2: set_integer(target, static_cast<long long>(static_cast<int>(read_be(data, length, pos, 4)))); return;
+            case 0xd3: set_integer(target, static_cast<long long>(read_be(data, length, pos, 8))); return;
+            case 0xdc: case 0xde: count = static_cast<size_t>(read_be(data, length, pos, 2)); break;
+            case 0xdd: case 0xdf: count = static_cast<size_t>(read_be(data, length, pos, 4)); break;
+            default:
+                throw parse_error("unsupported MessagePack type");
+            }
+
+            bool is_map = (marker & 0xf0) == 0x80 || marker == 0xde || marker == 0xdf;
+            if (count > length - pos) throw parse_error("unexpected end of MessagePack data");
+
+            if (!is_map) {
+                target.m_type = array;
+                target.m_array = new std::vector<json>();
+                target.m_array->reserve(count);
+                for (size_t i = 0; i < count; ++i) {
+                    target.m_array->push_back(json());
+                    read_msgpack(target.m_array->back(), data, length, pos);
+                }
+                return;
+            }
+
+            target.m_type = object;
+            target.m_object = new std::vector<std::pair<std::string, json>>();
+            target.m_object->reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                if (pos >= length) throw parse_error("unexpected end of MessagePack data");
+                unsigned char key_marker = data[pos++];
+                size_t key_length;
+                if ((key_marker & 0xe0) == 0xa0) key_length = key_marker & 0x1f;
+                else if (key_marker == 0xd9) key_length = static_cast<size_t>(read_be(data, length, pos, 1));
+                else if (key_marker == 0xda) key_length = static_cast<size_t>(read_be(data, length, pos, 2));
+                else if (key_marker == 0xdb) key_length = static_cast<size_t>(read_be(data, length, pos, 4));
+                else throw parse_error("MessagePack map key is not a string");
+                if (key_length > length - pos) throw parse_error("unexpected end of MessagePack data");
+
+                target.m_object->push_back(std::make_pair(
+                    std::string(reinterpret_cast<const char*>(data + pos), key_length), json()));
+                pos += key_length;
+                read_msgpack(target.m_object->back().second, data, length, pos);
+            }
+        }
+
+        // Major type and argument in the shortest form
+        template<typename Sink>
+        static void write_cbor_head(Sink& out, unsigned char major, unsigned long long value) {
+            unsigned char type = static_cast<unsigned char>(major << 5);
+            if (value < 24) write_be(out, static_cast<unsigned char>(type | value), 0, 0);
+            else if (value <= 0xFF) write_be(out, type | 24, value, 1);
+            else if (value <= 0xFFFF) write_be(out, type | 25, value, 2);
+            else if (value <= 0xFFFFFFFFULL) write_be(out, type | 26, value, 4);
+            else write_be(out, type | 27, value, 8);
+        }
+
+        template<typename Sink>
+        static void write_cbor_float(Sink& out, double value) {
+            if (value != value) {
+                write_be(out, 0xf9, 0x7e00, 2);   // canonical NaN
+                return;
+            }
+
+            float narrow = static_cast<float>(value);
+            if (static_cast<double>(narrow) != value) {
+                unsigned long long bits;
+                memcpy(&bits, &value, sizeof(bits));
+                write_be(out, 0xfb, bits, 8);
+                return;
+            }
+
+            unsigned int bits;
+            memcpy(&bits, &narrow, sizeof(bits));
+            unsigned int half;
+            if (float_to_half(bits, half)) write_be(out, 0xf9, half, 2);
+            else write_be(out, 0xfa, bits, 4);
+        }
+
+        // float32 bits to float16 bits, only when no precision is lost
+        static bool float_to_half(unsigned int bits, unsigned int& half) {
+            unsigned int sign = (bits >> 16) & 0x8000;
+            int exponent = static_cast<int>((bits >> 23) & 0xFF);
+            unsigned int mantissa = bits & 0x7FFFFF;
+
+            if (exponent == 0xFF) {
+                half = sign | 0x7C00;   // infinity (NaN is handled by the caller)
+                return mantissa == 0;
+            }
+            if (exponent == 0) {
+                half = sign;            // float32 subnormals are below float16 range
+                return mantissa == 0;
+            }
+
+            int e = exponent - 127;
+            if (e >= -14 && e <= 15) {
+                if (mantissa & 0x1FFF) return false;
+                half = sign | (static_cast<unsigned int>(e + 15) << 10) | (mantissa >> 13);
+                return true;
+            }
+            if (e >= -24 && e < -14) {
+                // float16 subnormal: value = m * 2^-24
+                unsigned int full = mantissa | 0x800000;
+                int shift = -(e + 1);
+                if (full & ((1u << shift) - 1)) return false;
+                half = sign | (full >> shift);
+                return true;
+            }
+            return false;
+        }
+
+        // float16 bits to float32 bits (always exact)
+        static unsigned int half_to_float(unsigned int half) {
+            unsigned int sign = (half & 0x8000) << 16;
+            int exponent = static_cast<int>((half >> 10) & 0x1F);
+            unsigned int mantissa = half & 0x3FF;
+
+            if (exponent == 31) return sign | 0x7F800000 | (mantissa << 13);
+            if (exponent == 0) {
+                if (mantissa == 0) return sign;
+                exponent = 1;
+                while (!(mantissa & 0x400)) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                mantissa &= 0x3FF;
+            }
+            return sign | (static_cast<unsigned int>(exponent - 15 + 127) << 23) | (mantissa << 13);
+        }
+
+        static void read_cbor(json& target, const unsigned char* data, size_t length, size_t& pos) {
+            if (pos >= length) throw parse_error("unexpected end of CBOR data");
+            unsigned char initial = data[pos++];
+            unsigned char major = initial >> 5;
+            unsigned char info = initial & 0x1F;
+
+            if (major == 7) {
+                switch (info) {
+                case 20: set_boolean(target, false); return;
+                case 21: set_boolean(target, true); return;
+                case 22: case 23: return;
+                case 25: set_float(target, bits_to_float(half_to_float(static_cast<unsigned int>(read_be(data, length, pos, 2))))); return;
+                case 26: set_float(target, bits_to_float(read_be(data, length, pos, 4))); return;
+                case 27: set_float(target, bits_to_double(read_be(data, length, pos, 8))); return;
+                case 31: throw parse_error("unexpected CBOR break");
+                default: throw parse_error("unsupported CBOR simple value");
+                }
+            }
+
+            bool indefinite = info == 31;
+            unsigned long long argument = 0;
+            if (indefinite) {
+                if (major < 2 || major == 6) throw parse_error("invalid indefinite CBOR item");
+            }
+            else {
+                argument = read_cbor_argument(data, length, pos, info);
+            }
+
+            switch (major) {
+            case 0:
+                if (argument > 0x7FFFFFFFFFFFFFFFULL) set_float(target, static_cast<double>(argument));
+                else set_integer(target, static_cast<long long>(argument));
+                return;
+            case 1:
+                if (argument > 0x7FFFFFFFFFFFFFFFULL) set_float(target, -1.0 - static_cast<double>(argument));
+                else set_integer(target, -1 - static_cast<long long>(argument));
+                return;
+            case 2:
+            case 3:
+                target.m_type = string;
+                target.m_string = new std::string();
+                read_cbor_string(*target.m_string, data, length, pos, major, indefinite, argument);
+                return;
+            case 6:
+                read_cbor(target, data, length, pos);   // tag: keep the tagged item
+                return;
+            case 4:
+                target.m_type = array;
+                target.m_array = new std::vector<json>();
+                if (!indefinite) {
+                    if (argument > length - pos) throw parse_error("unexpected end of CBOR data");
+                    target.m_array->reserve(static_cast<size_t>(argument));
+                }
+                for (unsigned long long i = 0; indefinite || i < argument; ++i) {
+                    if (indefinite && at_cbor_break(data, length, pos)) break;
+                    target.m_array->push_back(json());
+                    read_cbor(target.m_array->back(), data, length, pos);
+                }
+                return;
+            default:
+                target.m_type = object;
+                target.m_object = new std::vector<std::pair<std::string, json>>();
+                if (!indefinite) {
+                    if (argument > length - pos) throw parse_error("unexpected end of CBOR data");
+                    target.m_object->reserve(static_cast<size_t>(argument));
+                }
+                for (unsigned long long i = 0; indefinite || i < argument; ++i) {
+                    if (indefinite && at_cbor_break(data, length, pos)) break;
+                    if (pos >= length) throw parse_error("unexpected end of CBOR data");
+                    unsigned char key_initial = data[pos++];
+                    if ((key_initial >> 5) != 3) throw parse_error("CBOR map key is not a text string");
+                    bool key_indefinite = (key_initial & 0x1F) == 31;
+                    unsigned long long key_length = key_indefinite ? 0 :
+                        read_cbor_argument(data, length, pos, key_initial & 0x1F);
+
+                    target.m_object->push_back(std::make_pair(std::string(), json()));
+                    std::pair<std::string, json>& member = target.m_object->back();
+                    read_cbor_string(member.first, data, length, pos, 3, key_indefinite, key_length);
+                    read_cbor(member.second, data, length, pos);
+                }
+                return;
+            }
+        }
+
+        static unsigned long long read_cbor_argument(const unsigned char* data, size_t length, size_t& pos, unsigned char info) {
+            if (info < 24) return info;
+            if (info == 24) return read_be(data, length, pos, 1);
+            if (info == 25) return read_be(data, length, pos, 2);
+            if (info == 26) return read_be(data, length, pos, 4);
+            if (info == 27) return read_be(data, length, pos, 8);
+            throw parse_error("invalid CBOR additional information");
+        }
+
+        // Consume the break byte that ends an indefinite item, if it is next
+        static bool at_cbor_break(const unsigned char* data, size_t length, size_t& pos) {
+            if (pos >= length) throw parse_error("unexpected end of CBOR data");
+            if (data[pos] != 0xFF) return false;
+            ++pos;
+            return true;
+        }
+
+        // Definite string, or the chunks of an indefinite one (each chunk a
+        // definite string of the same major type)
+        static void read_cbor_string(std::string& out, const unsigned char* data, size_t length, size_t& pos,
+            unsigned char major, bool indefinite, unsigned long long size) {
+            if (!indefinite) {
+                if (size > length - pos) throw parse_error("unexpected end of CBOR data");
+                out.append(reinterpret_cast<const char*>(data + pos), static_cast<size_t>(size));
+                pos += static_cast<size_t>(size);
+                return;
+            }
+            while (!at_cbor_break(data, length, pos)) {
+                unsigned char initial = data[pos++];
+                if ((initial >> 5) != major || (initial & 0x1F) == 31) throw parse_error("invalid CBOR string chunk");
+                unsigned long long chunk = read_cbor_argument(data, length, pos, initial & 0x1F);
+                read_cbor_string(out, data, length, pos, major, false, chunk);
+            }
+        }
+
+        static void read_msgpack_string(json& target, const unsigned char* data, size_t length, size_t& pos, size_t size) {
+            if (size > length - pos) throw parse_error("unexpected end of MessagePack data");
+            target.m_type = string;
+            target.m_string = new std::string(reinterpret_cast<const char*>(data + pos), size);
+            pos += size;
+        }
+
+        static void skip_whitespace(const std::string& str, size_t& pos) {
+            skip_whitespace(str.data(), str.length(), pos);
+        }
+
+        static void skip_whitespace(const char* str, size_t length, size_t& pos) {
+            while (pos < length && (str[pos] == ' ' || str[pos] == '\n' ||
+                str[pos] == '\r' || str[pos] == '\t')) {
+                ++pos;
+            }
+        }
+
+        // What parse_options asks of the values parse_value() builds
+        struct parse_context {
+            shared_source* source;   // copy of the input being parsed
+            bool lazy_numbers;
+            bool lazy_strings;
+            std::vector<unsigned int> sizes;   // from count_elements(), if it ran
+            mutable size_t next_size;
+
+            parse_context() : source(nullptr), lazy_numbers(false), lazy_strings(false), next_size(0) {}
+        };
+
+        enum { count_depth = 64 };   // nesting count_elements() keeps counts for
+
+        // Structural pre-pass over the value at pos: the element count of
+        // every container, in the order the parser opens them, so each
+        // vector is allocated once at its final size. Only brackets, commas
+        // and quotes are looked at; malformed input just gives useless
+        // counts, the parser still rejects it. Containers nested deeper
+        // than count_depth are listed as 0 and grow as they fill.
+        // parse(), parse_insitu(), raw values and json_lazy::materialize()
+        // count first. parse_into() keeps the capacity the target already
+        // has, and parse_projected() builds too little to be worth a pass.
+        static void count_elements(const char* str, size_t length, size_t pos, std::vector<unsigned int>& sizes) {
+            size_t open[count_depth];   // index in sizes of each open container
+            size_t depth = 0;
+            skip_whitespace(str, length, pos);
+            if (pos >= length || (str[pos] != '[' && str[pos] != '{')) return;
+            for (; pos < length; ++pos) {
+                char c = str[pos];
+                if (c == '"') {
+                    ++pos;
+                    while (pos < length && str[pos] != '"') {
+                        if (str[pos] == '\\') ++pos;
+                        ++pos;
+                    }
+                }
+                else if (c == '[' || c == '{') {
+                    if (depth < count_depth) {
+                        size_t next = pos + 1;
+                        skip_whitespace(str, length, next);
+                        bool empty = next < length && (str[next] == ']' || str[next] == '}');
+                        open[depth] = sizes.size();
+                        sizes.push_back(empty ? 0 : 1);
+                    }
+                    else {
+                        sizes.push_back(0);
+                    }
+                    ++depth;
+                }
+                else if (c == ']' || c == '}') {
+                    if (--depth == 0) return;   // end of the value
+                }
+                else if (c == ',') {
+                    if (depth <= count_depth) ++sizes[open[depth - 1]];
+                }
+            }
+        }
+
+        // Step over the counts of the containers in [start, end), a subtree
+        // that is kept raw instead of being opened by the parser
+        static void skip_counts(const std::string& str, size_t start, size_t end, const parse_context* context) {
+            if (context->next_size >= context->sizes.size()) return;
+            for (size_t pos = start; pos < end; ++pos) {
+                char c = str[pos];
+                if (c == '"') {
+                    ++pos;
+                    while (pos < end && str[pos] != '"') {
+                        if (str[pos] == '\\') ++pos;
+                        ++pos;
+                    }
+                }
+                else if (c == '[' || c == '{') {
+                    ++context->next_size;
+                }
+            }
+        }
+
+        // Capacity for the container being opened, 0 when nothing was counted
+        static size_t counted_size(const parse_context* context) {
+            if (!context || context->next_size >= context->sizes.size()) return 0;
+            return context->sizes[context->next_size++];
+        }
+
+        static json parse_value(const std::string& str, size_t& pos, const parse_context* context = nullptr) {
+            skip_whitespace(str, pos);
+            if (pos >= str.length()) throw parse_error("unexpected end of input");
+
+            if (str[pos] == 'n') return parse_null(str, pos);
+            if (str[pos] == 't' || str[pos] == 'f') return parse_boolean(str, pos);
+            if (str[pos] == '"') return parse_string(str, pos, context);
+            if (str[pos] == '[') return parse_array(str, pos, context);
+            if (str[pos] == '{') return parse_object(str, pos, context);
+            if (str[pos] == '-' || (str[pos] >= '0' && str[pos] <= '9')) {
+                return parse_number(str, pos, context);
+            }
+
+            throw parse_error("unexpected character");
+        }
+
+        static json parse_null(const std::string& str, size_t& pos) {
+            if (str.compare(pos, 4, "null") != 0) throw parse_error("expected 'null'");
+            pos += 4;
+            return json();
+        }
+
+        static json parse_boolean(const std::string& str, size_t& pos) {
+            if (str.compare(pos, 4, "true") == 0) {
+                pos += 4;
+                return json(true);
+            }
+            if (str.compare(pos, 5, "false") == 0) {
+                pos += 5;
+                return json(false);
+            }
+            throw parse_error("expected 'true' or 'false'");
+        }
+
+        static json parse_string(const std::string& str, size_t& pos, const parse_context* context = nullptr) {
+            if (context && context->lazy_strings) return string_slice(str, pos, context->source);
+            return decoded_string(str, pos);
+        }
+
+        // Decoded straight into the node's storage; on its own so the
+        // return value is constructed in place
+        static json decoded_string(const std::string& str, size_t& pos) {
+            json result;
+            result.m_type = string;
+            result.m_string = new std::string();
+            read_string(str, pos, *result.m_string);
+            return result;
+        }
+
+        // String that keeps the inside of its literal in source, noting
+        // whether decoding it takes more than a copy
+        static json string_slice(const std::string& str, size_t& pos, shared_source* source) {
+            size_t start = pos + 1;
+            skip_string(str, pos);
+            size_t length = pos - 1 - start;
+            json result;
+            result.m_type = string;
+            result.make_source_slice(source, start, length);
+            result.m_value.slice.escaped = memchr(str.data() + start, '\\', length) != nullptr;
+            return result;
+        }
+
+        // Decode the string literal starting at pos (the opening quote) and
+        // append its content to result; pos ends up after the closing quote
+        static void read_string(const std::string& str, size_t& pos, std::string& result) {
+            if (str[pos] != '"') throw parse_error("expected '\"'");
+            ++pos;
+
+            while (pos < str.length() && str[pos] != '"') {
+                if (str[pos] == '\\') {
+                    ++pos;
+                    if (pos >= str.length()) throw parse_error("unterminated string");
+
+                    switch (str[pos]) {
+                    case '"': result += '"'; break;
+                    case '\\': result += '\\'; break;
+                    case '/': result += '/'; break;
+                    case 'b': result += '\b'; break;
+                    case 'f': result += '\f'; break;
+                    case 'n': result += '\n'; break;
+                    case 'r': result += '\r'; break;
+                    case 't': result += '\t'; break;
+                    case 'u': {
+                        ++pos;
+                        if (pos + 3 >= str.length()) throw parse_error("invalid unicode escape");
+                        unsigned int codepoint = 0;
+                        for (int i = 0; i < 4; ++i) {
+                            char c = str[pos + i];
+                            codepoint <<= 4;
+                            if (c >= '0' && c <= '9') codepoint |= (c - '0');
+                            else if (c >= 'a' && c <= 'f') codepoint |= (c - 'a' + 10);
+                            else if (c >= 'A' && c <= 'F') codepoint |= (c - 'A' + 10);
+                            else throw parse_error("invalid unicode escape");
+                        }
+                        char utf8[3];
+                        result.append(utf8, encode_utf8(codepoint, utf8));
+                        pos += 3;
+                        break;
+                    }
+                    default:
+                        throw parse_error("invalid escape sequence");
+                    }
+                }
+                else {
+                    // Plain run up to the next quote or escape, appended at once
+                    size_t end = pos + 1;
+                    while (end < str.length() && str[end] != '"' && str[end] != '\\') ++end;
+                    result.append(str, pos, end - pos);
+                    pos = end;
+                    continue;
+                }
+                ++pos;
+            }
+
+            if (pos >= str.length()) throw parse_error("unterminated string");
+            ++pos;
+        }
+
+        // UTF-8 bytes of a \u escape (at most 3, no surrogate pairing)
+        static size_t encode_utf8(unsigned int codepoint, char* out) {
+            if (codepoint <= 0x7F) {
+                out[0] = static_cast<char>(codepoint);
+                return 1;
+            }
+            if (codepoint <= 0x7FF) {
+                out[0] = static_cast<char>(0xC0 | ((codepoint >> 6) & 0x1F));
+                out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+                return 2;
+            }
+            out[0] = static_cast<char>(0xE0 | ((codepoint >> 12) & 0x0F));
+            out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+            return 3;
+        }
+
+        static json parse_number(const std::string& str, size_t& pos, const parse_context* context = nullptr) {
+            if (context && context->lazy_numbers) return number_slice(str, pos, context->source);
+            long long integer;
+            double floating;
+            if (read_number(str, pos, integer, floating)) return json(floating);
+            return json(integer);
+        }
+
+        // Number that keeps its digits in source; kept apart from
+        // parse_number() so the return value is constructed in place
+        static json number_slice(const std::string& str, size_t& pos, shared_source* source) {
+            size_t start = pos;
+            json result;
+            result.m_type = scan_number(str, pos) ? number_float : number_integer;
+            result.make_source_slice(source, start, pos - start);
+            return result;
+        }
+
+        // Scan the number at pos; returns true (and sets floating) when it has
+        // a fraction or exponent, false (and sets integer) otherwise
+        static bool read_number(const std::string& str, size_t& pos, long long& integer, double& floating) {
+            size_t start = pos;
+            bool is_float = scan_number(str, pos);
+
+            if (is_float) {
+                // atof stops where the number does, so no copy is needed
+                floating = atof(str.c_str() + start);
+                return true;
+            }
+            else {
+                long long result = 0;
+                bool negative = false;
+                size_t i = start;
+                if (str[i] == '-') {
+                    negative = true;
+                    ++i;
+                }
+                for (; i < pos; ++i) {
+                    result = result * 10 + (str[i] - '0');
+                }
+                integer = negative ? -result : result;
+                return false;
+            }
+        }
+
+        // Move pos past the number at pos; true when it has a fraction or exponent
+        static bool scan_number(const std::string& str, size_t& pos) {
+            return scan_number(str.data(), str.length(), pos);
+        }
+
+        static bool scan_number(const char* str, size_t length, size_t& pos) {
+            bool is_float = false;
+
+            if (str[pos] == '-') ++pos;
+
+            if (pos >= length || str[pos] < '0' || str[pos] > '9') {
+                throw parse_error("invalid number");
+            }
+
+            while (pos < length && str[pos] >= '0' && str[pos] <= '9') ++pos;
+
+            if (pos < length && str[pos] == '.') {
+                is_float = true;
+                ++pos;
+                while (pos < length && str[pos] >= '0' && str[pos] <= '9') ++pos;
+            }
+
+            if (pos < length && (str[pos] == 'e' || str[pos] == 'E')) {
+                is_float = true;
+                ++pos;
+                if (pos < length && (str[pos] == '+' || str[pos] == '-')) ++pos;
+                while (pos < length && str[pos] >= '0' && str[pos] <= '9') ++pos;
+            }
+
+            return is_float;
+        }
+
+        // Validate the value at pos and move past it without building
+        // anything; same grammar and messages as parse_value()
+        static void skip_value(const std::string& str, size_t& pos) {
+            skip_whitespace(str, pos);
+            if (pos >= str.length()) throw parse_error("unexpected end of input");
+
+            char c = str[pos];
+            if (c == '"') {
+                skip_string(str, pos);
+            }
+            else if (c == 'n') {
+                if (str.compare(pos, 4, "null") != 0) throw parse_error("expected 'null'");
+                pos += 4;
+            }
+            else if (c == 't' || c == 'f') {
+                if (str.compare(pos, 4, "true") == 0) pos += 4;
+                else if (str.compare(pos, 5, "false") == 0) pos += 5;
+                else throw parse_error("expected 'true' or 'false'");
+            }
+            else if (c == '-' || (c >= '0' && c <= '9')) {
+                scan_number(str, pos);
+            }
+            else if (c == '[' || c == '{') {
+                char closing = c == '[' ? ']' : '}';
+                ++pos;
+                skip_whitespace(str, pos);
+                if (pos < str.length() && str[pos] == closing) {
+                    ++pos;
+                    return;
+                }
+                while (true) {
+                    if (c == '{') {
+                        skip_whitespace(str, pos);
+                        skip_string(str, pos);
+                        skip_whitespace(str, pos);
+                        if (pos >= str.length() || str[pos] != ':') throw parse_error("expected ':'");
+                        ++pos;
+                    }
+                    skip_value(str, pos);
+                    skip_whitespace(str, pos);
+                    if (pos >= str.length()) throw parse_error(c == '[' ? "unterminated array" : "unterminated object");
+                    if (str[pos] == closing) {
+                        ++pos;
+                        break;
+                    }
+                    if (str[pos] != ',') throw parse_error(c == '[' ? "expected ',' or ']'" : "expected ',' or '}'");
+                    ++pos;
+                }
+            }
+            else {
+                throw parse_error("unexpected character");
+            }
+        }
+
+        // read_string() without the output
+        static void skip_string(const std::string& str, size_t& pos) {
+            if (pos >= str.length() || str[pos] != '"') throw parse_error("expected '\"'");
+            ++pos;
+
+            while (pos < str.length() && str[pos] != '"') {
+                if (str[pos] == '\\') {
+                    ++pos;
+                    if (pos >= str.length()) throw parse_error("unterminated string");
+                    switch (str[pos]) {
+                    case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                        break;
+                    case 'u':
+                        ++pos;
+                        if (pos + 3 >= str.length()) throw parse_error("invalid unicode escape");
+                        for (int i = 0; i < 4; ++i) {
+                            char c = str[pos + i];
+                            if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
+                                throw parse_error("invalid unicode escape");
+                            }
+                        }
+                        pos += 3;
+                        break;
+                    default:
+                        throw parse_error("invalid escape sequence");
+                    }
+                }
+                ++pos;
+            }
+
+            if (pos >= str.length()) throw parse_error("unterminated string");
+            ++pos;
+        }
+
+        // Move past the value at pos in text that skip_value() has already
+        // accepted. Only quotes and brackets matter, so this is a plain scan.
+        static void skip_valid(const std::string& str, size_t& pos) {
+            const char* data = str.data();
+            size_t length = str.length();
+            size_t depth = 0;
+            do {
+                char c = data[pos];
+                if (c == '"') {
+                    size_t start = ++pos;
+                    while (true) {
+                        pos = static_cast<const char*>(memchr(data + pos, '"', length - pos)) - data;
+                        size_t backslashes = 0;
+                        while (pos - backslashes > start && data[pos - backslashes - 1] == '\\') ++backslashes;
+                        ++pos;
+                        if (backslashes % 2 == 0) break;
+                    }
+                }
+                else if (c == '[' || c == '{') {
+                    ++depth;
+                    ++pos;
+                }
+                else if (c == ']' || c == '}') {
+                    --depth;
+                    ++pos;
+                }
+                else if (depth == 0) {
+                    // scalar: runs to the next delimiter
+                    while (pos < length && data[pos] != ',' && data[pos] != ']' && data[pos] != '}' &&
+                        data[pos] != ' ' && data[pos] != '\n' && data[pos] != '\r' && data[pos] != '\t') {
+                        ++pos;
+                    }
+                }
+                else {
+                    ++pos;
+                }
+            } while (depth > 0);
+        }
+
+        // Whether the string literal at pos equals key; decodes only when the
+        // literal has escapes (the literal must already be validated)
+        static bool literal_equals(const std::string& str, size_t pos, const std::string& key) {
+            const char* raw = str.data() + pos + 1;
+            size_t i = 0;
+            for (; i < key.length(); ++i) {
+                if (raw[i] == '\\') break;
+                if (raw[i] != key[i] || raw[i] == '"') return false;
+            }
+            if (i == key.length() && raw[i] == '"') return true;
+            if (raw[i] != '\\') return false;
+
+            std::string decoded;
+            read_string(str, pos, decoded);
+            return decoded == key;
+        }
+
+        // Paths given to parse_projected(), merged into a tree
+        struct projection_edge {
+            std::string key;
+            bool by_key;     // matches an object member named key
+            size_t index;    // matches this array element (json_pointer::npos for none)
+            size_t node;
+        };
+
+        struct projection {
+            bool whole;   // keep the entire subtree
+            std::vector<projection_edge> edges;
+            std::map<std::string, size_t> keys;   // member name -> edge
+            std::map<size_t, size_t> indices;     // array index -> edge
+
+            projection() : whole(false) {}
+        };
+
+        static void add_projection(std::vector<projection>& tree, const std::string& path) {
+            std::vector<projection_edge> steps;
+            if (!path.empty() && path[0] == '/') {
+                json_pointer ptr(path);
+                for (size_t i = 0; i < ptr.depth(); ++i) {
+                    projection_edge step;
+                    step.key = ptr.token(i);
+                    step.by_key = true;
+                    step.index = ptr.index(i);
+                    steps.push_back(step);
+                }
+            }
+            else {
+                std::vector<std::string> parts = split_path(path);
+                for (size_t i = 0; i < parts.size(); ++i) {
+                    projection_edge step;
+                    step.by_key = !is_numeric(parts[i]);
+                    step.index = step.by_key ? json_pointer::npos : string_to_size_t(parts[i]);
+                    if (step.by_key) step.key = parts[i];
+                    steps.push_back(step);
+                }
+            }
+
+            // "a.0" and "/a/0" name the same array element, so they share an
+            // edge; it also keeps the member name the pointer form matches
+            size_t node = 0;
+            for (size_t i = 0; i < steps.size() && !tree[node].whole; ++i) {
+                size_t edge = find_edge(tree[node], steps[i]);
+                if (edge == json_pointer::npos) {
+                    edge = tree[node].edges.size();
+                    steps[i].node = tree.size();
+                    tree[node].edges.push_back(steps[i]);
+                    if (steps[i].index != json_pointer::npos) tree[node].indices[steps[i].index] = edge;
+                    tree.push_back(projection());
+                }
+                projection_edge& found = tree[node].edges[edge];
+                if (steps[i].by_key && !found.by_key) {
+                    found.by_key = true;
+                    found.key = steps[i].key;
+                }
+                if (found.by_key) tree[node].keys[found.key] = edge;
+                node = found.node;
+            }
+            tree[node].whole = true;
+            tree[node].edges.clear();
+            tree[node].keys.clear();
+            tree[node].indices.clear();
+        }
+
+        // The edge of node that step shares, by index or by member name
+        static size_t find_edge(const projection& node, const projection_edge& step) {
+            if (step.index != json_pointer::npos) {
+                std::map<size_t, size_t>::const_iterator it = node.indices.find(step.index);
+                if (it != node.indices.end()) return it->second;
+            }
+            if (step.by_key) {
+                std::map<std::string, size_t>::const_iterator it = node.keys.find(step.key);
+                if (it != node.keys.end()) return it->second;
+            }
+            return json_pointer::npos;
+        }
+
+        // Parse the value at pos into result (a fresh null) against the path
+        // tree. Without a context this is parse_projected(): only what the
+        // tree selects is kept, and false means nothing was. With one (from
+        // parse_options) everything is kept and selected subtrees become raw.
+        static bool parse_projection(const std::string& str, size_t& pos,
+            const std::vector<projection>& tree, size_t node, json& result, const parse_context* context) {
+            skip_whitespace(str, pos);
+            if (pos >= str.length()) throw parse_error("unexpected end of input");
+            if (tree[node].whole && context) {
+                size_t start = pos;
+                skip_value(str, pos);
+                skip_counts(str, start, pos, context);
+                result.make_raw(context->source, start, pos - start);
+                return true;
+            }
+
+            const std::vector<projection_edge>& edges = tree[node].edges;
+            char c = str[pos];
+            if (tree[node].whole || (context && (edges.empty() || (c != '{' && c != '[')))) {
+                json value = parse_value(str, pos, context);
+                result.take(value);
+                return true;
+            }
+            if (c != '{' && c != '[') {
+                skip_value(str, pos);
+                return false;
+            }
+
+            size_t count = counted_size(context);
+            if (c == '{') {
+                result.m_type = object;
+                result.m_object = new std::vector<std::pair<std::string, json>>();
+                if (count) result.m_object->reserve(count);
+            }
+            else {
+                result.m_type = array;
+                result.m_array = new std::vector<json>();
+                if (count) result.m_array->reserve(count);
+            }
+
+            char closing = c == '[' ? ']' : '}';
+            ++pos;
+            skip_whitespace(str, pos);
+            if (pos < str.length() && str[pos] == closing) {
+                ++pos;
+                return false;
+            }
+
+            std::string name;   // reused for every member name
+            for (size_t index = 0; ; ++index) {
+                const projection_edge* match = nullptr;
+                if (c == '{') {
+                    skip_whitespace(str, pos);
+                    name.clear();
+                    read_string(str, pos, name);
+                    skip_whitespace(str, pos);
+                    if (pos >= str.length() || str[pos] != ':') throw parse_error("expected ':'");
+                    ++pos;
+                    std::map<std::string, size_t>::const_iterator it = tree[node].keys.find(name);
+                    if (it != tree[node].keys.end()) match = &edges[it->second];
+                }
+                else {
+                    std::map<size_t, size_t>::const_iterator it = tree[node].indices.find(index);
+                    if (it != tree[node].indices.end()) match = &edges[it->second];
+                }
+
+                json child;
+                bool keep = true;
+                if (match) {
+                    keep = parse_projection(str, pos, tree, match->node, child, context);
+                }
+                else if (context) {
+                    json value = parse_value(str, pos, context);
+                    child.take(value);
+                }
+                else {
+                    skip_value(str, pos);
+                    keep = false;
+                }
+                if (keep) {
+                    if (c == '{') {
+                        std::pair<std::string, json>& member = append_slot(*result.m_object);
+                        member.first = name;
+                        member.second.take(child);
+                    }
+                    else {
+                        // Elements skipped before this one stay null
+                        while (result.m_array->size() < index) append_slot(*result.m_array);
+                        append_slot(*result.m_array).take(child);
+                    }
+                }
+
+                skip_whitespace(str, pos);
+                if (pos >= str.length()) throw parse_error(c == '[' ? "unterminated array" : "unterminated object");
+                if (str[pos] == closing) {
+                    ++pos;
+                    break;
+                }
+                if (str[pos] != ',') throw parse_error(c == '[' ? "expected ',' or ']'" : "expected ',' or '}'");
+                ++pos;
+            }
+
+            return context || result.size() > 0;
+        }
+
+        // push_back() of a null element, but when the vector has to grow the
+        // existing elements are moved over with take() instead of deep-copied.
+        // Callers bump the owner's generation, as they do for any insertion.
+        static json& append_slot(std::vector<json>& items) {
+            if (items.size() == items.capacity()) grow_slots(items, items.empty() ? 4 : items.size() * 2);
+            items.push_back(json());
+            return items.back();
+        }
+
+        static std::pair<std::string, json>& append_slot(std::vector<std::pair<std::string, json>>& members) {
+            if (members.size() == members.capacity()) grow_slots(members, members.empty() ? 4 : members.size() * 2);
+            members.push_back(std::pair<std::string, json>());
+            return members.back();
+        }
+
+        // vector::reserve() that moves the elements with take(). Returns
+        // whether it reallocated; the owner has to bump its generation then,
+        // since pointers to the old children are dangling.
+        static bool grow_slots(std::vector<json>& items, size_t capacity) {
+            if (capacity <= items.capacity()) return false;
+            std::vector<json> grown;
+            grown.reserve(capacity);
+            grown.resize(items.size());
+            for (size_t i = 0; i < items.size(); ++i) {
+                grown[i].take(items[i]);
+            }
+            items.swap(grown);
+            return true;
+        }
+
+        static bool grow_slots(std::vector<std::pair<std::string, json>>& members, size_t capacity) {
+            if (capacity <= members.capacity()) return false;
+            std::vector<std::pair<std::string, json>> grown;
+            grown.reserve(capacity);
+            grown.resize(members.size());
+            for (size_t i = 0; i < members.size(); ++i) {
+                grown[i].first.swap(members[i].first);
+                grown[i].second.take(members[i].second);
+            }
+            members.swap(grown);
+            return true;
+        }
+
+        static json parse_array(const std::string& str, size_t& pos, const parse_context* context = nullptr) {
+            if (str[pos] != '[') throw parse_error("expected '['");
+            ++pos;
+
+            json result;
+            result.m_type = array;
+            result.m_array = new std::vector<json>();
+            result.m_array->reserve(counted_size(context));
+
+            skip_whitespace(str, pos);
+            if (pos < str.length() && str[pos] == ']') {
+                ++pos;
+                return result;
+            }
+
+            while (true) {
+                // Children are moved in with take(), not copied
+                json value = parse_value(str, pos, context);
+                append_slot(*result.m_array).take(value);
+                skip_whitespace(str, pos);
+
+                if (pos >= str.length()) throw parse_error("unterminated array");
+
+                if (str[pos] == ']') {
+                    ++pos;
+                    break;
+                }
+                else if (str[pos] == ',') {
+                    ++pos;
+                    skip_whitespace(str, pos);
+                }
+                else {
+                    throw parse_error("expected ',' or ']'");
+                }
+            }
+
+            return result;
+        }
+
+        static json parse_object(const std::string& str, size_t& pos, const parse_context* context = nullptr) {
+            if (str[pos] != '{') throw parse_error("expected '{'");
+            ++pos;
+
+            json result;
+            result.m_type = object;
+            result.m_object = new std::vector<std::pair<std::string, json>>();
+            result.m_object->reserve(counted_size(context));
+
+            skip_whitespace(str, pos);
+            if (pos < str.length() && str[pos] == '}') {
+                ++pos;
+                return result;
+            }
+
+            while (true) {
+                // The key is decoded into its slot; a parse error discards
+                // the whole object, half-filled member included
+                skip_whitespace(str, pos);
+                std::pair<std::string, json>& member = append_slot(*result.m_object);
+                read_string(str, pos, member.first);
+                skip_whitespace(str, pos);
+
+                if (pos >= str.length() || str[pos] != ':') {
+                    throw parse_error("expected ':'");
+                }
+                ++pos;
+
+                json value = parse_value(str, pos, context);
+                member.second.take(value);
+
+                skip_whitespace(str, pos);
+                if (pos >= str.length()) throw parse_error("unterminated object");
+
+                if (str[pos] == '}') {
+                    ++pos;
+                    break;
+                }
+                else if (str[pos] == ',') {
+                    ++pos;
+                }
+                else {
+                    throw parse_error("expected ',' or '}'");
+                }
+            }
+
+            return result;
+        }
+
+        // parse_into() counterparts of parse_value() and friends: same
+        // grammar and messages, but filling target in place
+        static void parse_value_into(const std::string& str, size_t& pos, json& target) {
+            skip_whitespace(str, pos);
+            if (pos >= str.length()) throw parse_error("unexpected end of input");
+
+            char c = str[pos];
+            if (c == '"') {
+                target.recycle_as(string);
+                target.m_string->clear();
+                read_string(str, pos, *target.m_string);
+            }
+            else if (c == '[') {
+                target.recycle_as(array);
+                parse_array_into(str, pos, *target.m_array);
+            }
+            else if (c == '{') {
+                target.recycle_as(object);
+                parse_object_into(str, pos, *target.m_object);
+            }
+            else {
+                json value = parse_value(str, pos);
+                target.take(value);
+                target.bump_generation();
+            }
+        }
+
+        // Keep the storage when the type stays the same, otherwise start
+        // over as an empty value of the new type
+        void recycle_as(value_t type) {
+            if (m_type != type || m_source) {
+                release();
+                m_type = type;
+                if (type == string) m_string = new std::string();
+                else if (type == array) m_array = new std::vector<json>();
+                else m_object = new std::vector<std::pair<std::string, json>>();
+            }
+            else if (m_fragment) {
+                drop_fragment();
+            }
+            bump_generation();
+        }
+
+        static void parse_array_into(const std::string& str, size_t& pos, std::vector<json>& items) {
+            ++pos;
+            size_t count = 0;
+
+            skip_whitespace(str, pos);
+            if (pos < str.length() && str[pos] == ']') {
+                ++pos;
+            }
+            else {
+                while (true) {
+                    json& slot = count < items.size() ? items[count] : append_slot(items);
+                    parse_value_into(str, pos, slot);
+                    ++count;
+                    skip_whitespace(str, pos);
+
+                    if (pos >= str.length()) throw parse_error("unterminated array");
+
+                    if (str[pos] == ']') {
+                        ++pos;
+                        break;
+                    }
+                    else if (str[pos] == ',') {
+                        ++pos;
+                        skip_whitespace(str, pos);
+                    }
+                    else {
+                        throw parse_error("expected ',' or ']'");
+                    }
+                }
+            }
+
+            if (count < items.size()) items.erase(items.begin() + count, items.end());
+        }
+
+        static void parse_object_into(const std::string& str, size_t& pos, std::vector<std::pair<std::string, json>>& members) {
+            ++pos;
+            size_t count = 0;
+
+            skip_whitespace(str, pos);
+            if (pos < str.length() && str[pos] == '}') {
+                ++pos;
+            }
+            else {
+                while (true) {
+                    skip_whitespace(str, pos);
+                    std::pair<std::string, json>& member = count < members.size() ? members[count] : append_slot(members);
+                    member.first.clear();
+                    read_string(str, pos, member.first);
+                    skip_whitespace(str, pos);
+
+                    if (pos >= str.length() || str[pos] != ':') {
+                        throw parse_error("expected ':'");
+                    }
+                    ++pos;
+
+                    parse_value_into(str, pos, member.second);
+                    ++count;
+
+                    skip_whitespace(str, pos);
+                    if (pos >= str.length()) throw parse_error("unterminated object");
+
+                    if (str[pos] == '}') {
+                        ++pos;
+                        break;
+                    }
+                    else if (str[pos] == ',') {
+                        ++pos;
+                    }
+                    else {
+                        throw parse_error("expected ',' or '}'");
+                    }
+                }
+            }
+
+            if (count < members.size()) members.erase(members.begin() + count, members.end());
+        }
+
+        // parse_insitu() counterparts of parse_value() and friends: same
+        // grammar and messages, over the caller's buffer
+        static json insitu_value(char* buf, size_t len, size_t& pos, const parse_context* context) {
+            skip_whitespace(buf, len, pos);
+            if (pos >= len) throw parse_error("unexpected end of input");
+
+            char c = buf[pos];
+            if (c == '"') return insitu_slice(buf, len, pos, context->source);
+            if (c == 'n') {
+                if (len - pos < 4 || memcmp(buf + pos, "null", 4) != 0) throw parse_error("expected 'null'");
+                pos += 4;
+                return json();
+            }
+            if (c == 't' || c == 'f') {
+                if (len - pos >= 4 && memcmp(buf + pos, "true", 4) == 0) {
+                    pos += 4;
+                    return json(true);
+                }
+                if (len - pos >= 5 && memcmp(buf + pos, "false", 5) == 0) {
+                    pos += 5;
+                    return json(false);
+                }
+                throw parse_error("expected 'true' or 'false'");
+            }
+            if (c == '[' || c == '{') return insitu_container(buf, len, pos, context);
+            if (c == '-' || (c >= '0' && c <= '9')) return insitu_number(buf, len, pos);
+
+            throw parse_error("unexpected character");
+        }
+
+        static json insitu_container(char* buf, size_t len, size_t& pos, const parse_context* context) {
+            bool is_array = buf[pos] == '[';
+            char closing = is_array ? ']' : '}';
+            ++pos;
+
+            json result;
+            if (is_array) {
+                result.m_type = array;
+                result.m_array = new std::vector<json>();
+                result.m_array->reserve(counted_size(context));
+            }
+            else {
+                result.m_type = object;
+                result.m_object = new std::vector<std::pair<std::string, json>>();
+                result.m_object->reserve(counted_size(context));
+            }
+
+            skip_whitespace(buf, len, pos);
+            if (pos < len && buf[pos] == closing) {
+                ++pos;
+                return result;
+            }
+
+            while (true) {
+                if (is_array) {
+                    json value = insitu_value(buf, len, pos, context);
+                    append_slot(*result.m_array).take(value);
+                }
+                else {
+                    skip_whitespace(buf, len, pos);
+                    size_t start;
+                    size_t length = insitu_string(buf, len, pos, start);
+                    skip_whitespace(buf, len, pos);
+                    if (pos >= len || buf[pos] != ':') throw parse_error("expected ':'");
+                    ++pos;
+
+                    json value = insitu_value(buf, len, pos, context);
+                    std::pair<std::string, json>& member = append_slot(*result.m_object);
+                    member.first.assign(buf + start, length);
+                    member.second.take(value);
+                }
+
+                skip_whitespace(buf, len, pos);
+                if (pos >= len) throw parse_error(is_array ? "unterminated array" : "unterminated object");
+                if (buf[pos] == closing) {
+                    ++pos;
+                    break;
+                }
+                if (buf[pos] != ',') throw parse_error(is_array ? "expected ',' or ']'" : "expected ',' or '}'");
+                ++pos;
+            }
+
+            return result;
+        }
+
+        static json insitu_slice(char* buf, size_t len, size_t& pos, shared_source* source) {
+            size_t start;
+            size_t length = insitu_string(buf, len, pos, start);
+            json result;
+            result.m_type = string;
+            result.make_source_slice(source, start, length);
+            return result;
+        }
+
+        // Decode the string literal at pos over itself; the decoded bytes
+        // start at start and their length is returned. Never longer than
+        // the literal, so writing trails reading.
+        static size_t insitu_string(char* buf, size_t len, size_t& pos, size_t& start) {
+            if (pos >= len || buf[pos] != '"') throw parse_error("expected '\"'");
+            ++pos;
+            start = pos;
+            size_t out = pos;
+
+            while (pos < len && buf[pos] != '"') {
+                if (buf[pos] == '\\') {
+                    ++pos;
+                    if (pos >= len) throw parse_error("unterminated string");
+
+                    switch (buf[pos]) {
+                    case '"': buf[out++] = '"'; break;
+                    case '\\': buf[out++] = '\\'; break;
+                    case '/': buf[out++] = '/'; break;
+                    case 'b': buf[out++] = '\b'; break;
+                    case 'f': buf[out++] = '\f'; break;
+                    case 'n': buf[out++] = '\n'; break;
+                    case 'r': buf[out++] = '\r'; break;
+                    case 't': buf[out++] = '\t'; break;
+                    case 'u': {
+                        ++pos;
+                        if (pos + 3 >= len) throw parse_error("invalid unicode escape");
+                        unsigned int codepoint = 0;
+                        for (int i = 0; i < 4; ++i) {
+                            char c = buf[pos + i];
+                            codepoint <<= 4;
+                            if (c >= '0' && c <= '9') codepoint |= (c - '0');
+                            else if (c >= 'a' && c <= 'f') codepoint |= (c - 'a' + 10);
+                            else if (c >= 'A' && c <= 'F') codepoint |= (c - 'A' + 10);
+                            else throw parse_error("invalid unicode escape");
+                        }
+                        out += encode_utf8(codepoint, buf + out);
+                        pos += 3;
+                        break;
+                    }
+                    default:
+                        throw parse_error("invalid escape sequence");
+                    }
+                }
+                else {
+                    buf[out++] = buf[pos];
+                }
+                ++pos;
+            }
+
+            if (pos >= len) throw parse_error("unterminated string");
+            ++pos;
+            return out - start;
+        }
+
+        // Like read_number(), but the buffer isn't terminated, so a float's
+        // digits are copied out for atof
+        static json insitu_number(const char* buf, size_t len, size_t& pos) {
+            size_t start = pos;
+            if (scan_number(buf, len, pos)) {
+                size_t count = pos - start;
+                char digits[64];
+                if (count < sizeof(digits)) {
+                    memcpy(digits, buf + start, count);
+                    digits[count] = '\0';
+                    return json(atof(digits));
+                }
+                return json(atof(std::string(buf + start, count).c_str()));
+            }
+
+            long long result = 0;
+            bool negative = false;
+            size_t i = start;
+            if (buf[i] == '-') {
+                negative = true;
+                ++i;
+            }
+            for (; i < pos; ++i) {
+                result = result * 10 + (buf[i] - '0');
+            }
+            return json(negative ? -result : result);
+        }
+    };
+
+    // Optional cache of at_path() resolutions for a long-lived document.
+    // Each entry remembers the containers it walked through together with
+    // their generation(). While no mutation has happened anywhere a hit is a
+    // single clock comparison; otherwise the recorded generations are checked
+    // from the root down (no string compares or scans) and the path is only
+    // walked again if one of its containers changed.
+    // The cache must not outlive the document it was created for.
+    class json_path_cache {
+    public:
+        explicit json_path_cache(const json& doc) : m_doc(&doc) {}
+
+        // Resolved node, or nullptr if the path doesn't exist
+        const json* find_path(const std::string& path) {
+            std::map<std::string, entry>::iterator it = m_entries.find(path);
+            if (it == m_entries.end()) {
+                it = m_entries.insert(std::make_pair(path, entry())).first;
+                resolve(it->first, it->second);
+            }
+            else if (!is_valid(it->second)) {
+                resolve(it->first, it->second);
+            }
+            return it->second.target;
+        }
+
+        const json& at_path(const std::string& path) {
+            const json* result = find_path(path);
+            if (!result) throw parse_error("path not found: " + path);
+            return *result;
+        }
+
+        bool has_path(const std::string& path) {
+            return find_path(path) != nullptr;
+        }
+
+        template<typename T>
+        T value_at_path(const std::string& path, const T& default_val) {
+            const json* val = find_path(path);
+            if (!val) return default_val;
+            return json::get_value_helper<T>(*val, default_val);
+        }
+
+        // Drop all cached entries
+        void clear() {
+            m_entries.clear();
+        }
+
+        size_t size() const {
+            return m_entries.size();
+        }
+
+    private:
+        struct link {
+            const json* node;
+            unsigned int generation;
+        };
+
+        struct entry {
+            std::vector<link> chain;
+            const json* target;
+            long long clock;
+
+            entry() : target(nullptr), clock(0) {}
+        };
+
+        json::clock_user m_clock_user;
+        const json* m_doc;
+        std::map<std::string, entry> m_entries;
+
+        bool is_valid(entry& e) const {
+            long long clock = json::current_clock();
+            if (e.clock == clock) return true;
+            if (json::generation_wrapped(e.clock, clock)) return false;
+
+            // Root first: while a container is unchanged its children haven't moved
+            for (size_t i = 0; i < e.chain.size(); ++i) {
+                if (e.chain[i].node->m_generation != e.chain[i].generation) return false;
+            }
+            e.clock = clock;
+            return true;
+        }
+
+        // Same resolution rules as json::at_path(); misses are cached too
+        void resolve(const std::string& path, entry& e) const {
+            std::vector<std::string> parts = json::split_path(path);
+            const json* current = m_doc;
+
+            e.chain.clear();
+            e.target = nullptr;
+            e.clock = json::current_clock();
+
+            for (size_t i = 0; i < parts.size(); ++i) {
+                current->resolve();
+                link l;
+                l.node = current;
+                l.generation = current->m_generation;
+                e.chain.push_back(l);
+
+                if (json::is_numeric(parts[i])) {
+                    if (current->m_type != json::array) return;
+                    size_t index = json::string_to_size_t(parts[i]);
+                    if (index >= current->m_array->size()) return;
+                    current = &(*current->m_array)[index];
+                }
+                else {
+                    if (current->m_type != json::object) return;
+                    const json* next = nullptr;
+                    for (size_t j = 0; j < current->m_object->size(); ++j) {
+                        if ((*current->m_object)[j].first == parts[i]) {
+                            next = &(*current->m_object)[j].second;
+                            break;
+                        }
+                    }
+                    if (!next) return;
+                    current = next;
+                }
+            }
+
+            e.target = current;
+        }
+    };
+
+    // Batch of set_path() updates applied as one transaction. Paths are split
+    // once, sorted and merged so every shared prefix is walked a single time,
+    // and missing intermediates are created in the same pass (objects, or
+    // arrays when every child segment is an index). The whole batch is
+    // validated before anything is written: either every update lands or the
+    // document is left untouched. Later updates win, exactly as if set_path()
+    // had been called in order.
+    class json_batch {
+    public:
+        json_batch() {}
+
+        json_batch& set(const std::string& path, const json& value) {
+            // No segments (e.g. "." or ".."): a no-op, as for set_path()
+            if (json::split_path(path).empty()) return *this;
+            m_updates.push_back(update());
+            m_updates.back().path = path;
+            m_updates.back().value = value;
+            return *this;
+        }
+
+        size_t size() const { return m_updates.size(); }
+        bool empty() const { return m_updates.empty(); }
+        void clear() { m_updates.clear(); }
+
+        // Apply every update or none (throws parse_error and leaves doc as it was)
+        void apply(json& doc) const {
+            std::vector<item> items(m_updates.size());
+            std::vector<size_t> order(m_updates.size());
+            for (size_t i = 0; i < m_updates.size(); ++i) {
+                items[i].parts = json::split_path(m_updates[i].path);
+                items[i].value = &m_updates[i].value;
+                items[i].seq = i;
+                order[i] = i;
+            }
+            if (items.empty()) return;
+
+            std::sort(order.begin(), order.end(), item_less(items));
+
+            // Dry run against the current document, then commit
+            walk(items, order, nullptr, &doc, 0, order.size(), 0, 0);
+            walk(items, order, &doc, &doc, 0, order.size(), 0, 0);
+        }
+
+        // Apply with error message instead of exception
+        bool apply_verbose(json& doc, std::string& error_msg) const {
+            try {
+                apply(doc);
+                return true;
+            }
+            catch (const parse_error& e) {
+                error_msg = e.what();
+                return false;
+            }
+        }
+
+    private:
+        struct update {
+            std::string path;
+            json value;
+        };
+
+        struct item {
+            std::vector<std::string> parts;
+            const json* value;
+            size_t seq;
+        };
+
+        struct item_less {
+            const std::vector<item>* items;
+            explicit item_less(const std::vector<item>& i) : items(&i) {}
+            bool operator()(size_t a, size_t b) const {
+                const item& x = (*items)[a];
+                const item& y = (*items)[b];
+                if (x.parts != y.parts) return x.parts < y.parts;
+                return x.seq < y.seq;
+            }
+        };
+
+        struct group {
+            size_t lo;
+            size_t hi;
+            size_t first_seq;
+        };
+
+        struct group_less {
+            bool operator()(const group& a, const group& b) const {
+                return a.first_seq < b.first_seq;
+            }
+        };
+
+        std::vector<update> m_updates;
+
+        // Process the sorted range [lo, hi), whose paths all share their first
+        // `depth` segments and lead to this node. In the dry run `node` is null
+        // and `state` is what the node will look like (nullptr: created as null).
+        // Updates older than `min_seq` were overwritten by an ancestor.
+        static void walk(const std::vector<item>& items, const std::vector<size_t>& order,
+            json* node, const json* state, size_t lo, size_t hi, size_t depth, size_t min_seq) {
+            size_t i = lo;
+            if (node) node->touch();
+
+            // Updates that end here: the newest live one wins
+            const item* own = nullptr;
+            while (i < hi && items[order[i]].parts.size() == depth) {
+                if (items[order[i]].seq >= min_seq) own = &items[order[i]];
+                ++i;
+            }
+            if (own) {
+                min_seq = own->seq;
+                if (node) *node = *own->value;
+                else state = own->value;
+            }
+
+            // Inspect the child segments that still have live updates
+            bool any_live = false;
+            bool any_key = false;
+            std::vector<size_t> indices;
+            for (size_t j = i; j < hi; ++j) {
+                const item& it = items[order[j]];
+                if (it.seq < min_seq) continue;
+                any_live = true;
+                const std::string& part = it.parts[depth];
+                if (json::is_numeric(part)) {
+                    indices.push_back(json::string_to_size_t(part));
+                }
+                else {
+                    any_key = true;
+                }
+            }
+            if (!any_live) return;
+
+            if (state) state->resolve();
+            json::value_t type = state ? state->m_type : json::null;
+            bool fresh = (type == json::null);
+            if (fresh) {
+                type = any_key ? json::object : json::array;
+
+                // A new array is filled the way appending would: indices
+                // 0, 1, 2, ... with no gaps, so its size is bounded by the
+                // number of updates instead of by the largest index
+                if (type == json::array) {
+                    std::sort(indices.begin(), indices.end());
+                    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+                    if (indices.back() != indices.size() - 1) {
+                        throw parse_error("array index out of range");
+                    }
+                }
+
+                if (node) {
+                    node->release();
+                    if (type == json::object) {
+                        node->m_type = json::object;
+                        node->m_object = new std::vector<std::pair<std::string, json>>();
+                    }
+                    else {
+                        node->m_type = json::array;
+                        node->m_array = new std::vector<json>(indices.size());
+                    }
+                    node->bump_generation();
+                }
+            }
+            if (type != json::object && type != json::array) {
+                throw parse_error("path element is not an object");
+            }
+
+            // Group the child segments; new keys are appended in the order the
+            // updates first reached them, as sequential set_path() calls would
+            std::vector<group> groups;
+            while (i < hi) {
+                const std::string& part = items[order[i]].parts[depth];
+                group g;
+                g.lo = i;
+                g.first_seq = static_cast<size_t>(-1);
+                while (i < hi && items[order[i]].parts[depth] == part) {
+                    size_t seq = items[order[i]].seq;
+                    if (seq >= min_seq && seq < g.first_seq) g.first_seq = seq;
+                    ++i;
+                }
+                g.hi = i;
+                if (g.first_seq != static_cast<size_t>(-1)) groups.push_back(g);
+            }
+            std::sort(groups.begin(), groups.end(), group_less());
+
+            // One lookup per distinct child segment
+            for (size_t g = 0; g < groups.size(); ++g) {
+                const std::string& part = items[order[groups[g].lo]].parts[depth];
+                json* child = nullptr;
+                const json* child_state = nullptr;
+
+                if (type == json::array) {
+                    if (!json::is_numeric(part)) {
+                        throw parse_error("path element is not an object");
+                    }
+                    size_t index = json::string_to_size_t(part);
+                    if (!fresh && index >= state->m_array->size()) {
+                        throw parse_error("array index out of range");
+                    }
+                    if (node) child = &(*node->m_array)[index];
+                    else if (!fresh) child_state = &(*state->m_array)[index];
+                }
+                else {
+                    if (json::is_numeric(part)) {
+                        throw parse_error("path element is not an array");
+                    }
+                    if (node) {
+                        child = &(*node)[part];
+                    }
+                    else if (!fresh) {
+                        for (size_t j = 0; j < state->m_object->size(); ++j) {
+                            if ((*state->m_object)[j].first == part) {
+                                child_state = &(*state->m_object)[j].second;
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                walk(items, order, child, node ? child : child_state,
+                    groups[g].lo, groups[g].hi, depth + 1, min_seq);
+            }
+        }
+    };
+
+    // Resumable serializer: produces the dump() output a piece at a time under
+    // a byte and/or node budget, keeping its position (down to the middle of
+    // a string) between calls. Spread a large save over many frames without
+    // copying the document. The document must outlive the serializer;
+    // structural changes made in between are detected and throw parse_error.
+    class json_serializer {
+    public:
+        json_serializer() : m_doc(nullptr), m_indent(-1) { reset_state(); }
+
+        explicit json_serializer(const json& doc, int indent = -1) {
+            reset(doc, indent);
+        }
+
+        // Start over (on another document or with another indent)
+        void reset(const json& doc, int indent = -1) {
+            m_doc = &doc;
+            m_indent = indent;
+            reset_state();
+        }
+
+        bool done() const {
+            return m_started && m_stack.empty() && !m_string && m_pending_pos == m_pending.length();
+        }
+
+        // Total bytes produced so far
+        size_t bytes_written() const { return m_total; }
+
+        // Write at most capacity bytes into buffer; with max_nodes > 0 stop
+        // after starting that many values. Returns the number of bytes written.
+        size_t step(char* buffer, size_t capacity, size_t max_nodes = 0) {
+            size_t nodes_left = max_nodes;
+            return produce(buffer, capacity, max_nodes > 0, nodes_left);
+        }
+
+        // Same budgets, appending to out
+        size_t step(std::string& out, size_t max_bytes, size_t max_nodes = 0) {
+            char chunk[4096];
+            size_t nodes_left = max_nodes;
+            size_t total = 0;
+            while (total < max_bytes && !done()) {
+                size_t room = max_bytes - total < sizeof(chunk) ? max_bytes - total : sizeof(chunk);
+                size_t written = produce(chunk, room, max_nodes > 0, nodes_left);
+                if (written == 0) break;
+                out.append(chunk, written);
+                total += written;
+            }
+            return total;
+        }
+
+    private:
+        struct frame {
+            const json* node;
+            unsigned int generation;
+            size_t index;
+            int current_indent;
+        };
+
+        enum { string_chunk = 256 };   // source bytes escaped per refill
+
+        json::clock_user m_clock_user;
+        const json* m_doc;
+        int m_indent;
+        bool m_started;
+        std::vector<frame> m_stack;
+        std::string m_pending;         // generated but not yet handed out
+        size_t m_pending_pos;
+        const json* m_string;          // string value being written
+        unsigned int m_string_generation;
+        size_t m_string_pos;
+        long long m_clock;
+        size_t m_total;
+
+        void reset_state() {
+            m_started = false;
+            m_stack.clear();
+            m_pending.clear();
+            m_pending_pos = 0;
+            m_string = nullptr;
+            m_string_generation = 0;
+            m_string_pos = 0;
+            m_clock = json::current_clock();
+            m_total = 0;
+        }
+
+        // Everything the saved position points into must be unchanged
+        void check_unchanged() {
+            long long clock = json::current_clock();
+            if (clock == m_clock) return;
+            if (json::generation_wrapped(m_clock, clock)) {
+                throw parse_error("document modified during serialization");
+            }
+            for (size_t i = 0; i < m_stack.size(); ++i) {
+                if (m_stack[i].node->m_generation != m_stack[i].generation) {
+                    throw parse_error("document modified during serialization");
+                }
+            }
+            if (m_string && m_string->m_generation != m_string_generation) {
+                throw parse_error("document modified during serialization");
+            }
+            m_clock = clock;
+        }
+
+        size_t produce(char* buffer, size_t capacity, bool limited, size_t& nodes_left) {
+            if (!m_doc) return 0;
+            check_unchanged();
+
+            size_t written = 0;
+            while (written < capacity) {
+                if (m_pending_pos < m_pending.length()) {
+                    size_t count = m_pending.length() - m_pending_pos;
+                    if (count > capacity - written) count = capacity - written;
+                    memcpy(buffer + written, m_pending.data() + m_pending_pos, count);
+                    m_pending_pos += count;
+                    written += count;
+                    continue;
+                }
+                m_pending.clear();
+                m_pending_pos = 0;
+
+                if (m_string) {
+                    refill_string();
+                    continue;
+                }
+                if (!m_started) {
+                    if (limited && nodes_left == 0) break;
+                    m_started = true;
+                    begin_value(*m_doc, 0);
+                    if (limited) --nodes_left;
+                    continue;
+                }
+                if (m_stack.empty()) break;
+
+                frame& top = m_stack.back();
+                const json& node = *top.node;
+                size_t count = node.m_type == json::array ? node.m_array->size() : node.m_object->size();
+                if (top.index == count) {
+                    if (m_indent >= 0) {
+                        m_pending += '\n';
+                        m_pending.append(top.current_indent, ' ');
+                    }
+                    m_pending += node.m_type == json::array ? ']' : '}';
+                    m_stack.pop_back();
+                    continue;
+                }
+
+                if (limited && nodes_left == 0) break;
+                if (top.index > 0) m_pending += ',';
+                if (m_indent >= 0) {
+                    if (top.index > 0) m_pending += '\n';
+                    m_pending.append(top.current_indent + m_indent, ' ');
+                }
+                int child_indent = top.current_indent + m_indent;
+                const json* child;
+                if (node.m_type == json::array) {
+                    child = &(*node.m_array)[top.index];
+                }
+                else {
+                    const std::string& key = (*node.m_object)[top.index].first;
+                    json::string_sink out(m_pending);
+                    out.put('"');
+                    json::write_escaped(out, key.data(), key.length());
+                    out.append("\":", 2);
+                    if (m_indent >= 0) out.put(' ');
+                    child = &(*node.m_object)[top.index].second;
+                }
+                ++top.index;
+                begin_value(*child, child_indent);   // may reallocate m_stack
+                if (limited) --nodes_left;
+            }
+
+            m_total += written;
+            return written;
+        }
+
+        // Queue the start of a value: scalars entirely, strings and non-empty
+        // containers are continued by later refills
+        void begin_value(const json& value, int current_indent) {
+            json::value_t type = value.load_type();   // raw nodes stay raw
+            if (type == json::string) {
+                m_pending += '"';
+                m_string = &value;
+                m_string_generation = value.m_generation;
+                m_string_pos = 0;
+            }
+            else if ((type == json::array && !value.m_array->empty()) ||
+                     (type == json::object && !value.m_object->empty())) {
+                m_pending += type == json::array ? '[' : '{';
+                if (m_indent >= 0) m_pending += '\n';
+                frame f;
+                f.node = &value;
+                f.generation = value.m_generation;
+                f.index = 0;
+                f.current_indent = current_indent;
+                m_stack.push_back(f);
+            }
+            else {
+                json::string_sink out(m_pending);
+                value.serialize(out, m_indent, current_indent);
+            }
+        }
+
+        // Escape the next piece of the current string; a lazy string's
+        // source text is copied as it is
+        void refill_string() {
+            bool verbatim = m_string->m_source && !m_string->m_source->insitu;
+            const char* data = verbatim ? m_string->source_text() : m_string->string_data();
+            size_t length = verbatim ? m_string->m_value.slice.length : m_string->string_length();
+            size_t count = length - m_string_pos;
+            if (count > string_chunk) count = string_chunk;
+            json::string_sink out(m_pending);
+            if (verbatim) out.append(data + m_string_pos, count);
+            else json::write_escaped(out, data + m_string_pos, count);
+            m_string_pos += count;
+            if (m_string_pos == length) {
+                m_pending += '"';
+                m_string = nullptr;
+            }
+        }
+    };
+
+    // Streaming CBOR writer for output whose size isn't known up front:
+    // containers may be opened without a count (indefinite length, closed by
+    // end()) or with one (definite length, end() writes nothing). Values are
+    // written with json::to_cbor(). The sink needs append(const char*, size_t).
+    template<typename Sink>
+    class json_cbor_writer {
+    public:
+        explicit json_cbor_writer(Sink& out) : m_out(&out) {}
+
+        json_cbor_writer& begin_array() { return open(0x9F); }
+        json_cbor_writer& begin_object() { return open(0xBF); }
+
+        json_cbor_writer& begin_array(size_t count) {
+            json::write_cbor_head(*m_out, 4, count);
+            m_open.push_back(false);
+            return *this;
+        }
+
+        json_cbor_writer& begin_object(size_t count) {
+            json::write_cbor_head(*m_out, 5, count);
+            m_open.push_back(false);
+            return *this;
+        }
+
+        // Member name inside an object; follow it with a value or a container
+        json_cbor_writer& key(const std::string& name) {
+            json::write_cbor_head(*m_out, 3, name.length());
+            m_out->append(name.data(), name.length());
+            return *this;
+        }
+
+        json_cbor_writer& value(const json& item) {
+            item.to_cbor(*m_out);
+            return *this;
+        }
+
+        // Close the innermost container
+        json_cbor_writer& end() {
+            if (m_open.empty()) throw parse_error("no open CBOR container");
+            if (m_open.back()) m_out->append("\xff", 1);
+            m_open.pop_back();
+            return *this;
+        }
+
+        // Containers not yet closed with end()
+        size_t depth() const { return m_open.size(); }
+
+    private:
+        Sink* m_out;
+        std::vector<bool> m_open;   // true for indefinite length
+
+        json_cbor_writer& open(unsigned char initial) {
+            char byte = static_cast<char>(initial);
+            m_out->append(&byte, 1);
+            m_open.push_back(true);
+            return *this;
+        }
+    };
+
+    namespace detail {
+        // value_at_path() conversions for the read-only views (json_view,
+        // json_tape::ref), same rules as json::get_value_helper
+        template<typename View, typename T>
+        inline T view_value(const View&, const T& default_val) {
+            return default_val;
+        }
+
+        template<typename View>
+        inline std::string view_value(const View& v, const std::string& default_val) {
+            return v.is_string() ? v.get_string() : default_val;
+        }
+
+        template<typename View>
+        inline int view_value(const View& v, const int& default_val) {
+            return v.is_number() ? static_cast<int>(v.get_int()) : default_val;
+        }
+
+        template<typename View>
+        inline long long view_value(const View& v, const long long& default_val) {
+            return v.is_number() ? v.get_int() : default_val;
+        }
+
+        template<typename View>
+        inline double view_value(const View& v, const double& default_val) {
+            return v.is_number() ? v.get_float() : default_val;
+        }
+
+        template<typename View>
+        inline float view_value(const View& v, const float& default_val) {
+            return v.is_number() ? static_cast<float>(v.get_float()) : default_val;
+        }
+
+        template<typename View>
+        inline bool view_value(const View& v, const bool& default_val) {
+            return v.is_boolean() ? v.get_bool() : default_val;
+        }
+
+        template<typename View>
+        inline unsigned int view_value(const View& v, const unsigned int& default_val) {
+            return v.is_number() ? static_cast<unsigned int>(v.get_int()) : default_val;
+        }
+    }
+
+    // Read-only node of a binary snapshot (see json::to_snapshot()). A view is
+    // two words and reads the snapshot in place: nothing is parsed or
+    // allocated, except for the std::string copies returned by get_string()
+    // and key(). Object lookups binary-search the per-object sorted index.
+    // Views must not outlive their json_snapshot.
+    class json_view {
+    public:
+        json_view() : m_image(nullptr), m_node(nullptr) {}
+
+        // Regions of an opened snapshot
+        struct image {
+            const char* nodes;
+            unsigned int node_count;
+            const char* keys;
+            unsigned int keys_size;
+            const char* strings;
+            unsigned int strings_size;
+        };
+
+        json_view(const image* snapshot, unsigned int index) : m_image(snapshot), m_node(nullptr) {
+            if (index >= snapshot->node_count) throw parse_error("corrupt snapshot");
+            m_node = snapshot->nodes + static_cast<size_t>(index) * detail::snapshot_node_size;
+        }
+
+        // A default-constructed view (e.g. from find()) refers to nothing
+        bool valid() const { return m_node != nullptr; }
+
+        json::value_t type() const {
+            if (!m_node) return json::null;
+            return static_cast<json::value_t>(static_cast<unsigned char>(m_node[0]));
+        }
+
+        bool is_null() const { return type() == json::null; }
+        bool is_boolean() const { return type() == json::boolean; }
+        bool is_number() const { return type() == json::number_integer || type() == json::number_float; }
+        bool is_string() const { return type() == json::string; }
+        bool is_array() const { return type() == json::array; }
+        bool is_object() const { return type() == json::object; }
+
+        bool get_bool() const {
+            if (type() != json::boolean) throw parse_error("not a boolean");
+            return word(1) != 0;
+        }
+
+        long long get_int() const {
+            if (type() == json::number_integer) return integer();
+            if (type() == json::number_float) return static_cast<long long>(floating());
+            throw parse_error("not a number");
+        }
+
+        double get_float() const {
+            if (type() == json::number_float) return floating();
+            if (type() == json::number_integer) return static_cast<double>(integer());
+            throw parse_error("not a number");
+        }
+
+        std::string get_string() const {
+            return std::string(c_str(), string_size());
+        }
+
+        // NUL-terminated string inside the snapshot (embedded NULs are kept;
+        // use string_size() for the length)
+        const char* c_str() const {
+            if (type() != json::string) throw parse_error("not a string");
+            return text(word(1), word(2));
+        }
+
+        size_t string_size() const {
+            if (type() != json::string) throw parse_error("not a string");
+            return word(2);
+        }
+
+        // Elements, members or string bytes, like json::size()
+        size_t size() const {
+            json::value_t t = type();
+            if (t == json::array || t == json::object || t == json::string) return word(1);
+            return 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        json_view operator[](size_t index) const {
+            if (type() != json::array) throw parse_error("not an array");
+            if (index >= word(1)) throw parse_error("index out of range");
+            return child(index);
+        }
+
+        json_view operator[](const std::string& key) const {
+            json_view result = find(key);
+            if (!result.valid()) throw parse_error("key not found");
+            return result;
+        }
+
+        json_view operator[](const char* key) const {
+            return (*this)[std::string(key)];
+        }
+
+        json_view at(size_t index) const { return (*this)[index]; }
+        json_view at(const std::string& key) const { return (*this)[key]; }
+
+        // Member by name, or an invalid view
+        json_view find(const std::string& key) const {
+            if (type() != json::object) throw parse_error("not an object");
+            size_t lo = 0;
+            size_t hi = word(1);
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                size_t member = sorted_member(mid);
+                if (compare_key(member, key) < 0) lo = mid + 1;
+                else hi = mid;
+            }
+            if (lo < word(1)) {
+                size_t member = sorted_member(lo);
+                if (compare_key(member, key) == 0) return child(member);
+            }
+            return json_view();
+        }
+
+        bool contains(const std::string& key) const {
+            return type() == json::object && find(key).valid();
+        }
+
+        // Members in insertion order: key(i) / value(i) for i < size()
+        std::string key(size_t i) const {
+            if (type() != json::object) throw parse_error("not an object");
+            if (i >= word(1)) throw parse_error("index out of range");
+            const char* entry = key_entry(i * 8, 8);
+            unsigned int offset = read_u32(entry);
+            unsigned int length = read_u32(entry + 4);
+            return std::string(text(offset, length), length);
+        }
+
+        json_view value(size_t i) const {
+            json::value_t t = type();
+            if (t != json::object && t != json::array) throw parse_error("not a container");
+            if (i >= word(1)) throw parse_error("index out of range");
+            return child(i);
+        }
+
+        // Same rules as json::at_path()
+        json_view at_path(const std::string& path) const {
+            json_view result = find_path(path);
+            if (!result.valid()) throw parse_error("path not found: " + path);
+            return result;
+        }
+
+        json_view find_path(const std::string& path) const {
+            std::vector<std::string> parts = json::split_path(path);
+            json_view current = *this;
+            for (size_t i = 0; i < parts.size() && current.valid(); ++i) {
+                if (json::is_numeric(parts[i])) {
+                    size_t index = json::string_to_size_t(parts[i]);
+                    if (current.type() != json::array || index >= current.size()) return json_view();
+                    current = current.child(index);
+                }
+                else {
+                    if (current.type() != json::object) return json_view();
+                    current = current.find(parts[i]);
+                }
+            }
+            return current;
+        }
+
+        bool has_path(const std::string& path) const {
+            return find_path(path).valid();
+        }
+
+        template<typename T>
+        T value_at_path(const std::string& path, const T& default_val) const {
+            json_view found = find_path(path);
+            if (!found.valid()) return default_val;
+            return detail::view_value(found, default_val);
+        }
+
+        // Walks members of an object or elements of an array
+        class iterator;
+
+        iterator begin() const;
+        iterator end() const;
+
+    private:
+        friend class json_snapshot;
+
+        const image* m_image;
+        const char* m_node;
+
+        static unsigned int read_u32(const char* p) {
+            unsigned int value;
+            memcpy(&value, p, 4);
+            return value;
+        }
+
+        // 32-bit field k (1..3) of the node record
+        unsigned int word(int k) const { return read_u32(m_node + 4 * k); }
+
+        long long integer() const {
+            long long value;
+            memcpy(&value, m_node + 8, 8);
+            return value;
+        }
+
+        double floating() const {
+            double value;
+            memcpy(&value, m_node + 8, 8);
+            return value;
+        }
+
+        json_view child(size_t i) const {
+            size_t index = static_cast<size_t>(word(2)) + i;
+            if (index >= m_image->node_count) throw parse_error("corrupt snapshot");
+            return json_view(m_image, static_cast<unsigned int>(index));
+        }
+
+        const char* text(unsigned int offset, unsigned int length) const {
+            if (offset > m_image->strings_size || length >= m_image->strings_size - offset) {
+                throw parse_error("corrupt snapshot");
+            }
+            return m_image->strings + offset;
+        }
+
+        // Bytes of this object's key table
+        const char* key_entry(size_t at, size_t bytes) const {
+            size_t offset = static_cast<size_t>(word(3)) + at;
+            if (offset > m_image->keys_size || bytes > m_image->keys_size - offset) {
+                throw parse_error("corrupt snapshot");
+            }
+            return m_image->keys + offset;
+        }
+
+        size_t sorted_member(size_t rank) const {
+            size_t member = read_u32(key_entry(static_cast<size_t>(word(1)) * 8 + rank * 4, 4));
+            if (member >= word(1)) throw parse_error("corrupt snapshot");
+            return member;
+        }
+
+        // Same order as std::string::compare (what the writer sorted by)
+        int compare_key(size_t member, const std::string& key) const {
+            const char* entry = key_entry(member * 8, 8);
+            unsigned int length = read_u32(entry + 4);
+            const char* name = text(read_u32(entry), length);
+            size_t common = length < key.length() ? length : key.length();
+            int result = memcmp(name, key.data(), common);
+            if (result != 0) return result;
+            if (length < key.length()) return -1;
+            return length > key.length() ? 1 : 0;
+        }
+
+    };
+
+    // Holds its own copy of the container view (two pointers), so iterating
+    // a temporary like snap.root()["items"] stays valid
+    class json_view::iterator {
+    public:
+        iterator(const json_view& owner, size_t index) : m_owner(owner), m_index(index) {}
+        std::string key() const { return m_owner.key(m_index); }
+        json_view value() const { return m_owner.value(m_index); }
+        json_view operator*() const { return value(); }
+        iterator& operator++() { ++m_index; return *this; }
+        bool operator==(const iterator& other) const { return m_owner.m_node == other.m_owner.m_node && m_index == other.m_index; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+    private:
+        json_view m_owner;
+        size_t m_index;
+    };
+
+    inline json_view::iterator json_view::begin() const { return iterator(*this, 0); }
+    inline json_view::iterator json_view::end() const { return iterator(*this, type() == json::object || type() == json::array ? size() : 0); }
+
+    // An opened binary snapshot: a memory-mapped file (shared between
+    // processes by the OS page cache) or a caller-owned buffer. The header
+    // and region bounds are checked on open; node reads are bounds-checked
+    // as they happen, so a damaged file throws parse_error instead of
+    // reading out of range.
+    class json_snapshot {
+    public:
+        json_snapshot() : m_data(nullptr), m_size(0) {
+            memset(&m_image, 0, sizeof(m_image));
+        }
+
+        bool open(const std::string& filepath) {
+            std::string error_msg;
+            return open_verbose(filepath, error_msg);
+        }
+
+        bool open_verbose(const std::string& filepath, std::string& error_msg) {
+            close();
+            if (!m_file.open(filepath)) {
+                error_msg = "Could not open file: " + filepath;
+                return false;
+            }
+            if (!attach(m_file.data(), m_file.size(), error_msg)) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        // Use a snapshot already in memory; data is not copied and must stay
+        // valid (and 4-byte aligned) while the snapshot is open
+        bool open(const char* data, size_t size) {
+            std::string error_msg;
+            close();
+            return attach(data, size, error_msg);
+        }
+
+        void close() {
+            m_file.close();
+            m_data = nullptr;
+            m_size = 0;
+            memset(&m_image, 0, sizeof(m_image));
+        }
+
+        bool is_open() const { return m_data != nullptr; }
+        size_t size() const { return m_size; }
+        size_t node_count() const { return m_image.node_count; }
+
+        json_view root() const {
+            if (!m_data) throw parse_error("snapshot not open");
+            return json_view(&m_image, 0);
+        }
+
+        // Rebuild the whole document as a mutable json in one linear pass
+        // over the nodes. Breadth-first order means a container's children
+        // are the next unclaimed nodes, so each container is allocated once
+        // at its final size and its slots become the targets of those
+        // nodes; nothing is parsed, grown or copied afterwards.
+        json to_json() const {
+            if (!m_data) throw parse_error("snapshot not open");
+
+            json result;
+            std::vector<json*> targets(m_image.node_count, nullptr);
+            targets[0] = &result;
+            size_t next = 1;
+
+            for (size_t i = 0; i < m_image.node_count; ++i) {
+                const char* node = m_image.nodes + i * detail::snapshot_node_size;
+                // Every node past the root has to be claimed by a container
+                // in front of it
+                if (i >= next) throw parse_error("corrupt snapshot");
+                json& target = *targets[i];
+                unsigned int a = json_view::read_u32(node + 4);
+                unsigned int b = json_view::read_u32(node + 8);
+
+                switch (static_cast<unsigned char>(node[0])) {
+                case json::null:
+                    break;
+                case json::boolean:
+                    json::set_boolean(target, a != 0);
+                    break;
+                case json::number_integer: {
+                    long long value;
+                    memcpy(&value, node + 8, 8);
+                    json::set_integer(target, value);
+                    break;
+                }
+                case json::number_float: {
+                    double value;
+                    memcpy(&value, node + 8, 8);
+                    json::set_float(target, value);
+                    break;
+                }
+                case json::string:
+                    target.m_type = json::string;
+                    target.m_string = new std::string(text(a, b), b);
+                    break;
+                case json::array:
+                    claim(next, a, b);
+                    target.m_type = json::array;
+                    target.m_array = new std::vector<json>(a);
+                    for (size_t j = 0; j < a; ++j) {
+                        targets[next + j] = &(*target.m_array)[j];
+                    }
+                    next += a;
+                    break;
+                case json::object: {
+                    claim(next, a, b);
+                    unsigned int keys = json_view::read_u32(node + 12);
+                    if (keys > m_image.keys_size || a > (m_image.keys_size - keys) / 8) {
+                        throw parse_error("corrupt snapshot");
+                    }
+                    target.m_type = json::object;
+                    target.m_object = new std::vector<std::pair<std::string, json>>(a);
+                    for (size_t j = 0; j < a; ++j) {
+                        const char* entry = m_image.keys + keys + j * 8;
+                        unsigned int offset = json_view::read_u32(entry);
+                        unsigned int length = json_view::read_u32(entry + 4);
+                        (*target.m_object)[j].first.assign(text(offset, length), length);
+                        targets[next + j] = &(*target.m_object)[j].second;
+                    }
+                    next += a;
+                    break;
+                }
+                default:
+                    throw parse_error("corrupt snapshot");
+                }
+            }
+            if (next != m_image.node_count) throw parse_error("corrupt snapshot");
+
+            return result;
+        }
+
+    private:
+        detail::mapped_file m_file;
+        const char* m_data;
+        size_t m_size;
+        json_view::image m_image;
+
+        bool attach(const char* data, size_t size, std::string& error_msg) {
+            detail::snapshot_header header;
+            if (size < sizeof(header)) {
+                error_msg = "Not a snapshot: file too small";
+                return false;
+            }
+            memcpy(&header, data, sizeof(header));
+            if (memcmp(header.magic, "TJSB", 4) != 0) {
+                error_msg = "Not a snapshot: bad magic";
+                return false;
+            }
+            if (header.byte_order != detail::snapshot_byte_order) {
+                error_msg = "Snapshot was written on a machine with a different byte order";
+                return false;
+            }
+            if (header.version != detail::snapshot_version) {
+                error_msg = "Unsupported snapshot version";
+                return false;
+            }
+
+            if (header.total_size != size || header.node_count == 0 ||
+                header.node_count > (size - sizeof(header)) / detail::snapshot_node_size ||
+                header.keys_offset != sizeof(header) + static_cast<size_t>(header.node_count) * detail::snapshot_node_size ||
+                header.keys_size > size - header.keys_offset ||
+                header.strings_offset != static_cast<size_t>(header.keys_offset) + header.keys_size ||
+                header.strings_size != size - header.strings_offset) {
+                error_msg = "Corrupt snapshot header";
+                return false;
+            }
+
+            m_data = data;
+            m_size = size;
+            m_image.nodes = data + sizeof(header);
+            m_image.node_count = header.node_count;
+            m_image.keys = data + header.keys_offset;
+            m_image.keys_size = header.keys_size;
+            m_image.strings = data + header.strings_offset;
+            m_image.strings_size = header.strings_size;
+            return true;
+        }
+
+        // Children must be exactly the next unclaimed nodes
+        void claim(size_t next, unsigned int count, unsigned int first) const {
+            if (first != next || count > m_image.node_count - next) {
+                throw parse_error("corrupt snapshot");
+            }
+        }
+
+        const char* text(unsigned int offset, unsigned int length) const {
+            if (offset > m_image.strings_size || length >= m_image.strings_size - offset) {
+                throw parse_error("corrupt snapshot");
+            }
+            return m_image.strings + offset;
+        }
+
+        json_snapshot(const json_snapshot&);
+        json_snapshot& operator=(const json_snapshot&);
+    };
+
+    // Read-only document stored as a flat tape of 64-bit words plus one
+    // string buffer, instead of a tree of heap nodes. Each word holds a type
+    // character in the top byte and a 56-bit payload:
+    //   '{' '['  index just past the matching end word (low 32 bits) and the
+    //            element count (bits 32-55, saturated), so skipping a whole
+    //            container is one jump
+    //   '}' ']'  index of the matching start word
+    //   '"'      offset into the string buffer (32-bit length, bytes, NUL);
+    //            object keys are strings too, each followed by its value
+    //   'l' 'd'  integer / double, raw value in the next word
+    //   't' 'f' 'n'
+    // Parsing into an existing tape reuses its buffers.
+    class json_tape {
+    public:
+        json_tape() {}
+
+        explicit json_tape(const std::string& text) {
+            parse(text);
+        }
+
+        // Replace the contents (throws parse_error and leaves the tape empty)
+        void parse(const std::string& text) {
+            m_tape.clear();
+            m_strings.clear();
+            m_stack.clear();
+            try {
+                build(text);
+            }
+            catch (...) {
+                m_tape.clear();
+                m_strings.clear();
+                throw;
+            }
+        }
+
+        bool empty() const { return m_tape.empty(); }
+
+        // Number of 64-bit words on the tape
+        size_t tape_size() const { return m_tape.size(); }
+
+        class ref;
+        ref root() const;
+
+        std::string dump(int indent = -1) const;
+
+        // Value on a tape; mirrors the const json API. Valid while the tape
+        // is alive and not parsed into again.
+        class ref {
+        public:
+            ref() : m_tape(nullptr), m_index(0) {}
+            ref(const json_tape* tape, size_t index) : m_tape(tape), m_index(index) {}
+
+            // A default-constructed ref (e.g. from find()) refers to nothing
+            bool valid() const { return m_tape != nullptr; }
+
+            json::value_t type() const {
+                switch (tag()) {
+                case '{': return json::object;
+                case '[': return json::array;
+                case '"': return json::string;
+                case 'l': return json::number_integer;
+                case 'd': return json::number_float;
+                case 't': case 'f': return json::boolean;
+                default: return json::null;
+                }
+            }
+
+            bool is_null() const { return type() == json::null; }
+            bool is_boolean() const { return type() == json::boolean; }
+            bool is_number() const { return tag() == 'l' || tag() == 'd'; }
+            bool is_string() const { return tag() == '"'; }
+            bool is_array() const { return tag() == '['; }
+            bool is_object() const { return tag() == '{'; }
+
+            bool get_bool() const {
+                if (tag() != 't' && tag() != 'f') throw parse_error("not a boolean");
+                return tag() == 't';
+            }
+
+            long long get_int() const {
+                if (tag() == 'l') return integer();
+                if (tag() == 'd') return static_cast<long long>(floating());
+                throw parse_error("not a number");
+            }
+
+            double get_float() const {
+                if (tag() == 'd') return floating();
+                if (tag() == 'l') return static_cast<double>(integer());
+                throw parse_error("not a number");
+            }
+
+            std::string get_string() const {
+                return std::string(c_str(), string_size());
+            }
+
+            // Bytes in the tape's string buffer, NUL-terminated (strings may
+            // contain NULs; use string_size() for the length)
+            const char* c_str() const {
+                if (tag() != '"') throw parse_error("not a string");
+                return m_tape->m_strings.data() + payload() + 4;
+            }
+
+            size_t string_size() const {
+                if (tag() != '"') throw parse_error("not a string");
+                unsigned int length;
+                memcpy(&length, m_tape->m_strings.data() + payload(), 4);
+                return length;
+            }
+
+            // Elements, members or string bytes, like json::size()
+            size_t size() const {
+                if (tag() == '"') return string_size();
+                if (tag() != '[' && tag() != '{') return 0;
+                size_t count = static_cast<size_t>(payload() >> 32);
+                if (count < count_saturated) return count;
+
+                count = 0;   // too many to store: count by walking
+                for (iterator it = begin(); it != end(); ++it) ++count;
+                return count;
+            }
+
+            bool empty() const {
+                if (tag() == '[' || tag() == '{') return end_index() == m_index + 1;
+                return size() == 0;
+            }
+
+            // Elements are reached by skipping their predecessors
+            ref operator[](size_t index) const {
+                if (tag() != '[') throw parse_error("not an array");
+                ref result = element(index);
+                if (!result.valid()) throw parse_error("index out of range");
+                return result;
+            }
+
+            ref operator[](const std::string& key) const {
+                ref result = find(key);
+                if (!result.valid()) throw parse_error("key not found");
+                return result;
+            }
+
+            ref operator[](const char* key) const {
+                return (*this)[std::string(key)];
+            }
+
+            ref at(size_t index) const { return (*this)[index]; }
+            ref at(const std::string& key) const { return (*this)[key]; }
+
+            // Member by name (first match), or an invalid ref
+            ref find(const std::string& key) const {
+                if (tag() != '{') throw parse_error("not an object");
+                for (iterator it = begin(); it != end(); ++it) {
+                    ref name(m_tape, it.m_index);
+                    if (name.string_size() == key.length() &&
+                        memcmp(name.c_str(), key.data(), key.length()) == 0) {
+                        return it.value();
+                    }
+                }
+                return ref();
+            }
+
+            bool contains(const std::string& key) const {
+                return tag() == '{' && find(key).valid();
+            }
+
+            // Same rules as json::at_path()
+            ref at_path(const std::string& path) const {
+                ref result = find_path(path);
+                if (!result.valid()) throw parse_error("path not found: " + path);
+                return result;
+            }
+
+            ref find_path(const std::string& path) const {
+                std::vector<std::string> parts = json::split_path(path);
+                ref current = *this;
+                for (size_t i = 0; i < parts.size() && current.valid(); ++i) {
+                    if (json::is_numeric(parts[i])) {
+                        if (current.tag() != '[') return ref();
+                        current = current.element(json::string_to_size_t(parts[i]));
+                    }
+                    else {
+                        if (current.tag() != '{') return ref();
+                        current = current.find(parts[i]);
+                    }
+                }
+                return current;
+            }
+
+            bool has_path(const std::string& path) const {
+                return find_path(path).valid();
+            }
+
+            template<typename T>
+            T value_at_path(const std::string& path, const T& default_val) const {
+                ref found = find_path(path);
+                if (!found.valid()) return default_val;
+                return detail::view_value(found, default_val);
+            }
+
+            // Walks members of an object or elements of an array
+            class iterator {
+            public:
+                iterator(const json_tape* tape, size_t index, bool members)
+                    : m_tape(tape), m_index(index), m_members(members) {}
+                std::string key() const { return ref(m_tape, m_index).get_string(); }
+                ref value() const { return ref(m_tape, m_members ? m_index + 1 : m_index); }
+                ref operator*() const { return value(); }
+                iterator& operator++() {
+                    m_index = json_tape::next_index(m_tape, m_members ? m_index + 1 : m_index);
+                    return *this;
+                }
+                bool operator==(const iterator& other) const { return m_index == other.m_index; }
+                bool operator!=(const iterator& other) const { return m_index != other.m_index; }
+            private:
+                friend class ref;
+                const json_tape* m_tape;
+                size_t m_index;    // element, or key of a member
+                bool m_members;
+            };
+
+            iterator begin() const {
+                bool container = tag() == '{' || tag() == '[';
+                return iterator(m_tape, container ? m_index + 1 : m_index, tag() == '{');
+            }
+
+            iterator end() const {
+                bool container = tag() == '{' || tag() == '[';
+                return iterator(m_tape, container ? end_index() : m_index, tag() == '{');
+            }
+
+            // Same output as json::dump()
+            std::string dump(int indent = -1) const {
+                if (!m_tape) throw parse_error("invalid tape reference");
+                std::string result;
+                json::string_sink out(result);
+                m_tape->write(out, m_index, indent, 0);
+                return result;
+            }
+
+        private:
+            const json_tape* m_tape;
+            size_t m_index;
+
+            char tag() const { return m_tape ? json_tape::tag_of(m_tape->m_tape[m_index]) : 'n'; }
+            unsigned long long payload() const { return json_tape::payload_of(m_tape->m_tape[m_index]); }
+
+            // Index of this container's end word
+            size_t end_index() const { return static_cast<size_t>(payload() & 0xFFFFFFFFULL) - 1; }
+
+            long long integer() const {
+                return static_cast<long long>(m_tape->m_tape[m_index + 1]);
+            }
+
+            double floating() const {
+                double value;
+                memcpy(&value, &m_tape->m_tape[m_index + 1], sizeof(value));
+                return value;
+            }
+
+            ref element(size_t index) const {
+                iterator it = begin();
+                for (size_t i = 0; i < index && it != end(); ++i) ++it;
+                return it == end() ? ref() : it.value();
+            }
+        };
+
+    private:
+        std::vector<unsigned long long> m_tape;
+        std::string m_strings;
+        std::vector<size_t> m_stack;   // start words of open containers while parsing
+
+        static const size_t count_saturated = 0xFFFFFF;
+
+        static char tag_of(unsigned long long word) { return static_cast<char>(word >> 56); }
+        static unsigned long long payload_of(unsigned long long word) { return word & 0x00FFFFFFFFFFFFFFULL; }
+
+        static unsigned long long make_word(char tag, unsigned long long payload) {
+            return (static_cast<unsigned long long>(static_cast<unsigned char>(tag)) << 56) | payload;
+        }
+
+        // Index of the value following the one at index
+        static size_t next_index(const json_tape* tape, size_t index) {
+            unsigned long long word = tape->m_tape[index];
+            switch (tag_of(word)) {
+            case '{': case '[': return static_cast<size_t>(payload_of(word) & 0xFFFFFFFFULL);
+            case 'l': case 'd': return index + 2;
+            default: return index + 1;
+            }
+        }
+
+        void append_string(const std::string& text, size_t& pos) {
+            size_t offset = m_strings.size();
+            if (offset > 0xFFFFFFFFu) throw parse_error("document too large for a tape");
+            m_strings.append(4, '\0');
+            json::read_string(text, pos, m_strings);
+            size_t length = m_strings.size() - offset - 4;
+            unsigned int stored = static_cast<unsigned int>(length);
+            memcpy(&m_strings[offset], &stored, 4);
+            m_strings += '\0';
+            m_tape.push_back(make_word('"', offset));
+        }
+
+        // Key of an object member, through the ':'
+        void append_key(const std::string& text, size_t& pos) {
+            json::skip_whitespace(text, pos);
+            if (pos >= text.length() || text[pos] != '"') throw parse_error("expected '\"'");
+            append_string(text, pos);
+            json::skip_whitespace(text, pos);
+            if (pos >= text.length() || text[pos] != ':') throw parse_error("expected ':'");
+            ++pos;
+        }
+
+        // Fill in the innermost container's start word and add its end word
+        void close_container(char closing) {
+            size_t start = m_stack.back();
+            m_stack.pop_back();
+            size_t after = m_tape.size() + 1;
+            if (after > 0xFFFFFFFFu) throw parse_error("document too large for a tape");
+
+            size_t count = 0;
+            for (size_t i = start + 1; i < m_tape.size() && count < count_saturated; ++count) {
+                i = next_index(this, closing == '}' ? i + 1 : i);
+            }
+            m_tape[start] = make_word(tag_of(m_tape[start]),
+                (static_cast<unsigned long long>(count) << 32) | after);
+            m_tape.push_back(make_word(closing, start));
+        }
+
+        // Iterative version of json::parse(): same grammar and messages, no recursion
+        void build(const std::string& text) {
+            size_t pos = 0;
+            json::skip_whitespace(text, pos);
+            if (pos >= text.length()) throw parse_error("empty input");
+
+            bool need_value = true;
+            for (;;) {
+                if (need_value) {
+                    json::skip_whitespace(text, pos);
+                    if (pos >= text.length()) throw parse_error("unexpected end of input");
+                    char c = text[pos];
+
+                    if (c == '[' || c == '{') {
+                        char closing = c == '[' ? ']' : '}';
+                        m_stack.push_back(m_tape.size());
+                        m_tape.push_back(make_word(c, 0));
+                        ++pos;
+                        json::skip_whitespace(text, pos);
+                        if (pos < text.length() && text[pos] == closing) {
+                            ++pos;
+                            close_container(closing);
+                            need_value = false;
+                        }
+                        else if (c == '{') {
+                            append_key(text, pos);
+                        }
+                        continue;
+                    }
+
+                    if (c == '"') {
+                        append_string(text, pos);
+                    }
+                    else if (c == 'n') {
+                        if (text.compare(pos, 4, "null") != 0) throw parse_error("expected 'null'");
+                        pos += 4;
+                        m_tape.push_back(make_word('n', 0));
+                    }
+                    else if (c == 't' || c == 'f') {
+                        if (text.compare(pos, 4, "true") == 0) {
+                            pos += 4;
+                            m_tape.push_back(make_word('t', 0));
+                        }
+                        else if (text.compare(pos, 5, "false") == 0) {
+                            pos += 5;
+                            m_tape.push_back(make_word('f', 0));
+                        }
+                        else {
+                            throw parse_error("expected 'true' or 'false'");
+                        }
+                    }
+                    else if (c == '-' || (c >= '0' && c <= '9')) {
+                        long long integer;
+                        double floating;
+                        unsigned long long bits;
+                        if (json::read_number(text, pos, integer, floating)) {
+                            memcpy(&bits, &floating, sizeof(bits));
+                            m_tape.push_back(make_word('d', 0));
+                        }
+                        else {
+                            bits = static_cast<unsigned long long>(integer);
+                            m_tape.push_back(make_word('l', 0));
+                        }
+                        m_tape.push_back(bits);
+                    }
+                    else {
+                        throw parse_error("unexpected character");
+                    }
+                    need_value = false;
+                }
+
+                // A value is complete: close containers or move to the next one
+                if (m_stack.empty()) break;
+                bool in_object = tag_of(m_tape[m_stack.back()]) == '{';
+                json::skip_whitespace(text, pos);
+                if (pos >= text.length()) throw parse_error(in_object ? "unterminated object" : "unterminated array");
+
+                if (text[pos] == ',') {
+                    ++pos;
+                    if (in_object) append_key(text, pos);
+                    need_value = true;
+                }
+                else if (text[pos] == (in_object ? '}' : ']')) {
+                    ++pos;
+                    close_container(in_object ? '}' : ']');
+                }
+                else {
+                    throw parse_error(in_object ? "expected ',' or '}'" : "expected ',' or ']'");
+                }
+            }
+
+            json::skip_whitespace(text, pos);
+            if (pos < text.length()) throw parse_error("unexpected data after JSON");
+        }
+
+        template<typename Sink>
+        void write(Sink& out, size_t index, int indent, int current_indent) const {
+            unsigned long long word = m_tape[index];
+            switch (tag_of(word)) {
+            case 'n':
+                out.append("null", 4);
+                break;
+            case 't':
+                out.append("true", 4);
+                break;
+            case 'f':
+                out.append("false", 5);
+                break;
+            case 'l':
+                json::write_int(out, static_cast<long long>(m_tape[index + 1]));
+                break;
+            case 'd': {
+                double value;
+                memcpy(&value, &m_tape[index + 1], sizeof(value));
+                json::write_float(out, value);
+                break;
+            }
+            case '"': {
+                ref value(this, index);
+                out.put('"');
+                json::write_escaped(out, value.c_str(), value.string_size());
+                out.put('"');
+                break;
+            }
+            default: {
+                bool is_object = tag_of(word) == '{';
+                size_t end = static_cast<size_t>(payload_of(word) & 0xFFFFFFFFULL) - 1;
+                out.put(is_object ? '{' : '[');
+                if (indent >= 0 && end != index + 1) {
+                    out.put('\n');
+                }
+                for (size_t i = index + 1; i < end;) {
+                    if (indent >= 0) {
+                        out.fill(current_indent + indent, ' ');
+                    }
+                    if (is_object) {
+                        write(out, i, -1, 0);
+                        out.put(':');
+                        if (indent >= 0) {
+                            out.put(' ');
+                        }
+                        ++i;
+                    }
+                    write(out, i, indent, current_indent + indent);
+                    i = next_index(this, i);
+                    if (i < end) {
+                        out.put(',');
+                    }
+                    if (indent >= 0) {
+                        out.put('\n');
+                    }
+                }
+                if (indent >= 0 && end != index + 1) {
+                    out.fill(current_indent, ' ');
+                }
+                out.put(is_object ? '}' : ']');
+                break;
+            }
+            }
+        }
+    };
+
+    inline json_tape::ref json_tape::root() const {
+        if (m_tape.empty()) throw parse_error("empty tape");
+        return ref(this, 0);
+    }
+
+    inline std::string json_tape::dump(int indent) const {
+        return root().dump(indent);
+    }
+
+    // On-demand document: construction only validates the text, and values
+    // are decoded when they are read. Looking up a member or element walks
+    // the container and steps over everything in front of it by bracket
+    // matching, so untouched subtrees are never parsed. Suits reading a few
+    // fields out of a large message; materialize() gives a full json.
+    class json_lazy {
+    public:
+        json_lazy() {}
+
+        explicit json_lazy(const std::string& text) {
+            parse(text);
+        }
+
+        // Replace the contents with a copy of text (throws parse_error and
+        // leaves the document empty)
+        void parse(const std::string& text) {
+            m_text = text;
+            m_opens.clear();
+            m_ends.clear();
+            try {
+                size_t pos = 0;
+                json::skip_whitespace(m_text, pos);
+                if (pos >= m_text.length()) throw parse_error("empty input");
+                m_root = pos;
+                json::skip_value(m_text, pos);
+                json::skip_whitespace(m_text, pos);
+                if (pos < m_text.length()) throw parse_error("unexpected data after JSON");
+            }
+            catch (...) {
+                m_text.clear();
+                throw;
+            }
+            build_index();
+        }
+
+        bool empty() const { return m_text.empty(); }
+
+        // The validated source text
+        const std::string& text() const { return m_text; }
+
+        class ref;
+        ref root() const;
+
+        json materialize() const;
+
+        // Value in a json_lazy document; mirrors the const json API. Valid
+        // while the document is alive and not parsed into again.
+        class ref {
+        public:
+            ref() : m_doc(nullptr), m_pos(0) {}
+            ref(const json_lazy* doc, size_t pos) : m_doc(doc), m_pos(pos) {}
+
+            // A default-constructed ref (e.g. from find()) refers to nothing
+            bool valid() const { return m_doc != nullptr; }
+
+            json::value_t type() const {
+                switch (first()) {
+                case '{': return json::object;
+                case '[': return json::array;
+                case '"': return json::string;
+                case 't': case 'f': return json::boolean;
+                case 'n': return json::null;
+                default: {
+                    size_t pos = m_pos;
+                    return json::scan_number(m_doc->m_text, pos) ? json::number_float : json::number_integer;
+                }
+                }
+            }
+
+            bool is_null() const { return first() == 'n'; }
+            bool is_boolean() const { return first() == 't' || first() == 'f'; }
+            bool is_number() const { return first() == '-' || (first() >= '0' && first() <= '9'); }
+            bool is_string() const { return first() == '"'; }
+            bool is_array() const { return first() == '['; }
+            bool is_object() const { return first() == '{'; }
+
+            bool get_bool() const {
+                if (!is_boolean()) throw parse_error("not a boolean");
+                return first() == 't';
             }
-        }
 
-    private:
-        value_t m_type;
-        union {
-            bool boolean;
-            long long number_integer;
-            double number_float;
-        } m_value;
-        std::string* m_string;
-        std::vector<std::pair<std::string, json>>* m_object;
-        std::vector<json>* m_array;
+            long long get_int() const {
+                if (!is_number()) throw parse_error("not a number");
+                long long integer;
+                double floating;
+                size_t pos = m_pos;
+                if (json::read_number(m_doc->m_text, pos, integer, floating)) return static_cast<long long>(floating);
+                return integer;
+            }
 
-        void copy_from(const json& other) {
-            m_value = other.m_value;
-            if (other.m_string) {
-                m_string = new std::string(*other.m_string);
+            double get_float() const {
+                if (!is_number()) throw parse_error("not a number");
+                long long integer;
+                double floating;
+                size_t pos = m_pos;
+                if (json::read_number(m_doc->m_text, pos, integer, floating)) return floating;
+                return static_cast<double>(integer);
             }
-            if (other.m_object) {
-                m_object = new std::vector<std::pair<std::string, json>>(*other.m_object);
+
+            // Decoded on every call
+            std::string get_string() const {
+                if (!is_string()) throw parse_error("not a string");
+                std::string result;
+                size_t pos = m_pos;
+                json::read_string(m_doc->m_text, pos, result);
+                return result;
             }
-            if (other.m_array) {
-                m_array = new std::vector<json>(*other.m_array);
+
+            // Elements, members or string bytes, like json::size()
+            size_t size() const {
+                if (is_string()) return get_string().length();
+                size_t count = 0;
+                for (iterator it = begin(); it != end(); ++it) ++count;
+                return count;
             }
-        }
 
-        // Helper for value() method with type checking
-        template<typename T>
-        static T get_value_helper(const json& j, const T& default_val) {
-            return default_val;  // Generic fallback
-        }
+            bool empty() const {
+                if (is_object() || is_array()) return begin() == end();
+                return size() == 0;
+            }
 
-        // Helper to split path by dots
-        static std::vector<std::string> split_path(const std::string& path) {
-            std::vector<std::string> parts;
-            std::string current;
+            ref operator[](size_t index) const {
+                if (!is_array()) throw parse_error("not an array");
+                ref result = element(index);
+                if (!result.valid()) throw parse_error("index out of range");
+                return result;
+            }
 
-            for (size_t i = 0; i < path.length(); ++i) {
-                if (path[i] == '.') {
-                    if (!current.empty()) {
-                        parts.push_back(current);
-                        current.clear();
-                    }
-                }
-                else {
-                    current += path[i];
-                }
+            ref operator[](const std::string& key) const {
+                ref result = find(key);
+                if (!result.valid()) throw parse_error("key not found");
+                return result;
             }
 
-            if (!current.empty()) {
-                parts.push_back(current);
+            ref operator[](const char* key) const {
+                return (*this)[std::string(key)];
             }
 
-            return parts;
-        }
+            ref at(size_t index) const { return (*this)[index]; }
+            ref at(const std::string& key) const { return (*this)[key]; }
 
-        // Xbox 360 compatible number to string conversion
-        static std::string int_to_string(long long value) {
-            char buffer[32];
-            sprintf(buffer, "%lld", value);
-            return std::string(buffer);
-        }
+            // Member by name (first match), or an invalid ref
+            ref find(const std::string& key) const {
+                if (!is_object()) throw parse_error("not an object");
+                for (iterator it = begin(); it != end(); ++it) {
+                    if (json::literal_equals(m_doc->m_text, it.m_pos, key)) return it.value();
+                }
+                return ref();
+            }
 
-        static std::string size_to_string(size_t value) {
-            char buffer[32];
-            sprintf(buffer, "%zu", static_cast<unsigned long>(value));
-            return std::string(buffer);
-        }
+            bool contains(const std::string& key) const {
+                return is_object() && find(key).valid();
+            }
 
-        // Check if string is numeric (for array indices)
-        static bool is_numeric(const std::string& str) {
-            if (str.empty()) return false;
-            for (size_t i = 0; i < str.length(); ++i) {
-                if (str[i] < '0' || str[i] > '9') return false;
+            // Same as json::value(): default_val when missing or of another type
+            template<typename T>
+            T value(const std::string& key, const T& default_val) const {
+                if (!is_object()) return default_val;
+                ref found = find(key);
+                if (!found.valid()) return default_val;
+                return detail::view_value(found, default_val);
             }
-            return true;
-        }
 
-        // Convert string to size_t
-        static size_t string_to_size_t(const std::string& str) {
-            size_t result = 0;
-            for (size_t i = 0; i < str.length(); ++i) {
-                result = result * 10 + (str[i] - '0');
+            // Same rules as json::at_path()
+            ref at_path(const std::string& path) const {
+                ref result = find_path(path);
+                if (!result.valid()) throw parse_error("path not found: " + path);
+                return result;
             }
-            return result;
-        }
 
-        static std::string escape_string(const std::string& str) {
-            std::string result;
-            for (size_t i = 0; i < str.length(); ++i) {
-                switch (str[i]) {
-                case '"': result += "\\\""; break;
-                case '\\': result += "\\\\"; break;
-                case '\b': result += "\\b"; break;
-                case '\f': result += "\\f"; break;
-                case '\n': result += "\\n"; break;
-                case '\r': result += "\\r"; break;
-                case '\t': result += "\\t"; break;
-                default:
-                    if (str[i] < 0x20) {
-                        char buffer[7];
-                        sprintf(buffer, "\\u%04x", static_cast<unsigned char>(str[i]));
-                        result += buffer;
+            ref find_path(const std::string& path) const {
+                std::vector<std::string> parts = json::split_path(path);
+                ref current = *this;
+                for (size_t i = 0; i < parts.size() && current.valid(); ++i) {
+                    if (json::is_numeric(parts[i])) {
+                        if (!current.is_array()) return ref();
+                        current = current.element(json::string_to_size_t(parts[i]));
                     }
                     else {
-                        result += str[i];
+                        if (!current.is_object()) return ref();
+                        current = current.find(parts[i]);
                     }
                 }
+                return current;
             }
-            return result;
-        }
 
-        static void skip_whitespace(const std::string& str, size_t& pos) {
-            while (pos < str.length() && (str[pos] == ' ' || str[pos] == '\n' ||
-                str[pos] == '\r' || str[pos] == '\t')) {
-                ++pos;
+            bool has_path(const std::string& path) const {
+                return find_path(path).valid();
             }
-        }
 
-        static json parse_value(const std::string& str, size_t& pos) {
-            skip_whitespace(str, pos);
-            if (pos >= str.length()) throw parse_error("unexpected end of input");
-
-            if (str[pos] == 'n') return parse_null(str, pos);
-            if (str[pos] == 't' || str[pos] == 'f') return parse_boolean(str, pos);
-            if (str[pos] == '"') return parse_string(str, pos);
-            if (str[pos] == '[') return parse_array(str, pos);
-            if (str[pos] == '{') return parse_object(str, pos);
-            if (str[pos] == '-' || (str[pos] >= '0' && str[pos] <= '9')) {
-                return parse_number(str, pos);
+            template<typename T>
+            T value_at_path(const std::string& path, const T& default_val) const {
+                ref found = find_path(path);
+                if (!found.valid()) return default_val;
+                return detail::view_value(found, default_val);
             }
 
-            throw parse_error("unexpected character");
-        }
-
-        static json parse_null(const std::string& str, size_t& pos) {
-            if (str.substr(pos, 4) != "null") throw parse_error("expected 'null'");
-            pos += 4;
-            return json();
-        }
-
-        static json parse_boolean(const std::string& str, size_t& pos) {
-            if (str.substr(pos, 4) == "true") {
-                pos += 4;
-                return json(true);
-            }
-            if (str.substr(pos, 5) == "false") {
-                pos += 5;
-                return json(false);
-            }
-            throw parse_error("expected 'true' or 'false'");
-        }
+            // Walks members of an object or elements of an array; end() is
+            // known without scanning ahead
+            class iterator {
+            public:
+                iterator() : m_doc(nullptr), m_pos(std::string::npos), m_value(0), m_members(false) {}
+
+                iterator(const json_lazy* doc, size_t open)
+                    : m_doc(doc), m_pos(std::string::npos), m_value(0), m_members(doc->m_text[open] == '{') {
+                    size_t pos = open + 1;
+                    json::skip_whitespace(m_doc->m_text, pos);
+                    enter(pos);
+                }
 
-        static json parse_string(const std::string& str, size_t& pos) {
-            if (str[pos] != '"') throw parse_error("expected '\"'");
-            ++pos;
+                std::string key() const {
+                    std::string result;
+                    size_t pos = m_pos;
+                    json::read_string(m_doc->m_text, pos, result);
+                    return result;
+                }
 
-            std::string result;
-            while (pos < str.length() && str[pos] != '"') {
-                if (str[pos] == '\\') {
-                    ++pos;
-                    if (pos >= str.length()) throw parse_error("unterminated string");
+                ref value() const { return ref(m_doc, m_value); }
+                ref operator*() const { return value(); }
 
-                    switch (str[pos]) {
-                    case '"': result += '"'; break;
-                    case '\\': result += '\\'; break;
-                    case '/': result += '/'; break;
-                    case 'b': result += '\b'; break;
-                    case 'f': result += '\f'; break;
-                    case 'n': result += '\n'; break;
-                    case 'r': result += '\r'; break;
-                    case 't': result += '\t'; break;
-                    case 'u': {
+                iterator& operator++() {
+                    const std::string& text = m_doc->m_text;
+                    size_t pos = m_doc->skip(m_value);
+                    json::skip_whitespace(text, pos);
+                    if (text[pos] == ',') {
                         ++pos;
-                        if (pos + 3 >= str.length()) throw parse_error("invalid unicode escape");
-                        unsigned int codepoint = 0;
-                        for (int i = 0; i < 4; ++i) {
-                            char c = str[pos + i];
-                            codepoint <<= 4;
-                            if (c >= '0' && c <= '9') codepoint |= (c - '0');
-                            else if (c >= 'a' && c <= 'f') codepoint |= (c - 'a' + 10);
-                            else if (c >= 'A' && c <= 'F') codepoint |= (c - 'A' + 10);
-                            else throw parse_error("invalid unicode escape");
-                        }
-                        if (codepoint <= 0x7F) {
-                            result += static_cast<char>(codepoint);
-                        }
-                        else if (codepoint <= 0x7FF) {
-                            result += static_cast<char>(0xC0 | ((codepoint >> 6) & 0x1F));
-                            result += static_cast<char>(0x80 | (codepoint & 0x3F));
-                        }
-                        else {
-                            result += static_cast<char>(0xE0 | ((codepoint >> 12) & 0x0F));
-                            result += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
-                            result += static_cast<char>(0x80 | (codepoint & 0x3F));
-                        }
-                        pos += 3;
-                        break;
-                    }
-                    default:
-                        throw parse_error("invalid escape sequence");
+                        json::skip_whitespace(text, pos);
                     }
+                    enter(pos);
+                    return *this;
                 }
-                else {
-                    result += str[pos];
+
+                bool operator==(const iterator& other) const { return m_pos == other.m_pos; }
+                bool operator!=(const iterator& other) const { return m_pos != other.m_pos; }
+
+            private:
+                friend class ref;
+                const json_lazy* m_doc;
+                size_t m_pos;     // element or member key; npos at the end
+                size_t m_value;
+                bool m_members;
+
+                void enter(size_t pos) {
+                    const std::string& text = m_doc->m_text;
+                    if (text[pos] == ']' || text[pos] == '}') {
+                        m_pos = std::string::npos;
+                        return;
+                    }
+                    m_pos = pos;
+                    if (m_members) {
+                        json::skip_valid(text, pos);
+                        json::skip_whitespace(text, pos);
+                        ++pos;   // ':'
+                        json::skip_whitespace(text, pos);
+                    }
+                    m_value = pos;
                 }
-                ++pos;
-            }
+            };
 
-            if (pos >= str.length()) throw parse_error("unterminated string");
-            ++pos;
-            return json(result);
-        }
+            iterator begin() const {
+                if (!is_object() && !is_array()) return iterator();
+                return iterator(m_doc, m_pos);
+            }
 
-        static json parse_number(const std::string& str, size_t& pos) {
-            size_t start = pos;
-            bool is_float = false;
+            iterator end() const { return iterator(); }
 
-            if (str[pos] == '-') ++pos;
+            // Parse this value (only) into a json
+            json materialize() const {
+                if (!m_doc) throw parse_error("invalid lazy reference");
+                size_t pos = m_pos;
+                json::parse_context context;
+                json::count_elements(m_doc->m_text.data(), m_doc->m_text.length(), pos, context.sizes);
+                return json::parse_value(m_doc->m_text, pos, &context);
+            }
 
-            if (pos >= str.length() || str[pos] < '0' || str[pos] > '9') {
-                throw parse_error("invalid number");
+            // Source text of this value, as it appears in the input
+            std::string raw() const {
+                if (!m_doc) return std::string();
+                return m_doc->m_text.substr(m_pos, m_doc->skip(m_pos) - m_pos);
             }
 
-            while (pos < str.length() && str[pos] >= '0' && str[pos] <= '9') ++pos;
+        private:
+            const json_lazy* m_doc;
+            size_t m_pos;   // first character of the value
 
-            if (pos < str.length() && str[pos] == '.') {
-                is_float = true;
-                ++pos;
-                while (pos < str.length() && str[pos] >= '0' && str[pos] <= '9') ++pos;
-            }
+            char first() const { return m_doc ? m_doc->m_text[m_pos] : 'n'; }
 
-            if (pos < str.length() && (str[pos] == 'e' || str[pos] == 'E')) {
-                is_float = true;
-                ++pos;
-                if (pos < str.length() && (str[pos] == '+' || str[pos] == '-')) ++pos;
-                while (pos < str.length() && str[pos] >= '0' && str[pos] <= '9') ++pos;
+            ref element(size_t index) const {
+                iterator it = begin();
+                for (size_t i = 0; i < index && it != end(); ++i) ++it;
+                return it == end() ? ref() : it.value();
             }
+        };
 
-            std::string num_str = str.substr(start, pos - start);
-            if (is_float) {
-                return json(atof(num_str.c_str()));
-            }
-            else {
-                long long result = 0;
-                bool negative = false;
-                size_t i = 0;
-                if (num_str[0] == '-') {
-                    negative = true;
-                    i = 1;
+    private:
+        std::string m_text;
+        size_t m_root;
+
+        // Structural index built by parse(): the offset of every array and
+        // object's opening bracket, in document order, and the offset just
+        // past its closing one. Stepping over a sibling container is a
+        // binary search instead of a scan of its contents.
+        std::vector<size_t> m_opens;
+        std::vector<size_t> m_ends;
+
+        void build_index() {
+            const char* data = m_text.data();
+            size_t length = m_text.length();
+            std::vector<size_t> unclosed;
+            for (size_t pos = 0; pos < length; ++pos) {
+                char c = data[pos];
+                if (c == '"') {
+                    size_t start = ++pos;
+                    while (true) {
+                        pos = static_cast<const char*>(memchr(data + pos, '"', length - pos)) - data;
+                        size_t backslashes = 0;
+                        while (pos - backslashes > start && data[pos - backslashes - 1] == '\\') ++backslashes;
+                        if (backslashes % 2 == 0) break;
+                        ++pos;
+                    }
                 }
-                for (; i < num_str.length(); ++i) {
-                    result = result * 10 + (num_str[i] - '0');
+                else if (c == '[' || c == '{') {
+                    unclosed.push_back(m_opens.size());
+                    m_opens.push_back(pos);
+                    m_ends.push_back(0);
+                }
+                else if (c == ']' || c == '}') {
+                    m_ends[unclosed.back()] = pos + 1;
+                    unclosed.pop_back();
                 }
-                return json(negative ? -result : result);
             }
         }
 
-        static json parse_array(const std::string& str, size_t& pos) {
-            if (str[pos] != '[') throw parse_error("expected '['");
-            ++pos;
+        // Offset just past the value starting at pos
+        size_t skip(size_t pos) const {
+            char c = m_text[pos];
+            if (c == '[' || c == '{') {
+                return m_ends[std::lower_bound(m_opens.begin(), m_opens.end(), pos) - m_opens.begin()];
+            }
+            json::skip_valid(m_text, pos);
+            return pos;
+        }
+    };
 
-            json result;
-            result.m_type = array;
-            result.m_array = new std::vector<json>();
+    inline json_lazy::ref json_lazy::root() const {
+        if (m_text.empty()) throw parse_error("empty document");
+        return ref(this, m_root);
+    }
 
-            skip_whitespace(str, pos);
-            if (pos < str.length() && str[pos] == ']') {
-                ++pos;
-                return result;
-            }
+    inline json json_lazy::materialize() const {
+        return root().materialize();
+    }
 
-            while (true) {
-                result.m_array->push_back(parse_value(str, pos));
-                skip_whitespace(str, pos);
+#ifndef TINYJSON_NO_THREADS
+    // Background writer built on save_to_file_atomic(). save() copies the
+    // document and returns immediately; a worker thread writes each file at
+    // most once per interval, so saves of the same path in between coalesce
+    // into one write of the newest copy. Callbacks run on the worker thread
+    // (or inside flush()) after the write that covered them has finished.
+    class json_async_writer {
+    public:
+        typedef void (*callback_t)(const std::string& filepath, bool success, const std::string& error_msg, void* user_data);
 
-                if (pos >= str.length()) throw parse_error("unterminated array");
+        explicit json_async_writer(unsigned int interval_ms = 1000)
+            : m_interval_ms(interval_ms), m_stop(false), m_running(false) {
+            m_running = m_thread.start(&json_async_writer::run, this);
+        }
 
-                if (str[pos] == ']') {
-                    ++pos;
-                    break;
-                }
-                else if (str[pos] == ',') {
-                    ++pos;
-                    skip_whitespace(str, pos);
+        // Writes whatever is still pending before returning
+        ~json_async_writer() {
+            {
+                detail::lock_guard guard(m_mutex);
+                m_stop = true;
+            }
+            m_stop_event.signal();
+            m_work_event.signal();
+            m_thread.join();
+            flush();
+        }
+
+        void save(const json& doc, const std::string& filepath, int indent = 2,
+            callback_t callback = nullptr, void* user_data = nullptr) {
+            json* snapshot = new json(doc);
+            json* replaced = nullptr;
+            {
+                detail::lock_guard guard(m_mutex);
+                pending_save* entry = nullptr;
+                for (size_t i = 0; i < m_pending.size(); ++i) {
+                    if (m_pending[i].filepath == filepath) {
+                        entry = &m_pending[i];
+                        break;
+                    }
                 }
-                else {
-                    throw parse_error("expected ',' or ']'");
+                if (!entry) {
+                    m_pending.push_back(pending_save());
+                    entry = &m_pending.back();
+                    entry->filepath = filepath;
+                    entry->doc = nullptr;
                 }
+                replaced = entry->doc;
+                entry->doc = snapshot;
+                entry->indent = indent;
+                if (callback) entry->callbacks.push_back(std::make_pair(callback, user_data));
             }
+            delete replaced;
 
-            return result;
+            if (m_running) m_work_event.signal();
+            else flush();
         }
 
-        static json parse_object(const std::string& str, size_t& pos) {
-            if (str[pos] != '{') throw parse_error("expected '{'");
-            ++pos;
+        // Write everything pending now, on the calling thread
+        void flush() {
+            detail::lock_guard io_guard(m_io_mutex);
 
-            json result;
-            result.m_type = object;
-            result.m_object = new std::vector<std::pair<std::string, json>>();
+            std::vector<pending_save> batch;
+            {
+                detail::lock_guard guard(m_mutex);
+                batch.swap(m_pending);
+            }
 
-            skip_whitespace(str, pos);
-            if (pos < str.length() && str[pos] == '}') {
-                ++pos;
-                return result;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                std::string error_msg;
+                bool success = batch[i].doc->save_to_file_atomic_verbose(batch[i].filepath, batch[i].indent, error_msg);
+                delete batch[i].doc;
+                for (size_t j = 0; j < batch[i].callbacks.size(); ++j) {
+                    batch[i].callbacks[j].first(batch[i].filepath, success, error_msg, batch[i].callbacks[j].second);
+                }
             }
+        }
 
-            while (true) {
-                skip_whitespace(str, pos);
-                json key = parse_string(str, pos);
-                skip_whitespace(str, pos);
+        // Number of files waiting to be written
+        size_t pending() {
+            detail::lock_guard guard(m_mutex);
+            return m_pending.size();
+        }
 
-                if (pos >= str.length() || str[pos] != ':') {
-                    throw parse_error("expected ':'");
-                }
-                ++pos;
+    private:
+        struct pending_save {
+            std::string filepath;
+            json* doc;
+            int indent;
+            std::vector<std::pair<callback_t, void*>> callbacks;
+        };
 
-                json value = parse_value(str, pos);
-                result.m_object->push_back(std::make_pair(key.get_string(), value));
+        unsigned int m_interval_ms;
+        bool m_stop;
+        bool m_running;
+        std::vector<pending_save> m_pending;
+        detail::mutex m_mutex;
+        detail::mutex m_io_mutex;
+        detail::event m_work_event;
+        detail::event m_stop_event;
+        detail::thread m_thread;
+
+        static void run(void* self) {
+            static_cast<json_async_writer*>(self)->loop();
+        }
 
-                skip_whitespace(str, pos);
-                if (pos >= str.length()) throw parse_error("unterminated object");
+        bool stopping() {
+            detail::lock_guard guard(m_mutex);
+            return m_stop;
+        }
 
-                if (str[pos] == '}') {
-                    ++pos;
-                    break;
-                }
-                else if (str[pos] == ',') {
-                    ++pos;
-                }
-                else {
-                    throw parse_error("expected ',' or '}'");
-                }
-            }
+        void loop() {
+            while (!stopping()) {
+                m_work_event.wait(m_interval_ms);
+                if (stopping() || pending() == 0) continue;
 
-            return result;
+                // Let further saves coalesce for one interval (cut short on shutdown)
+                m_stop_event.wait(m_interval_ms);
+                flush();
+            }
         }
+
+        json_async_writer(const json_async_writer&);
+        json_async_writer& operator=(const json_async_writer&);
     };
+#endif
 
     // Template helper functions
     template <typename T>
@@ -1276,4 +7037,16 @@ namespace tinyjson {
         }
         return default_val;
     }
+    inline json json::load_snapshot(const std::string& filepath) {
+        json_snapshot snapshot;
+        std::string error_msg;
+        if (!snapshot.open_verbose(filepath, error_msg)) throw parse_error(error_msg);
+        return snapshot.to_json();
+    }
+
+    inline json json::from_snapshot(const char* data, size_t size) {
+        json_snapshot snapshot;
+        if (!snapshot.open(data, size)) throw parse_error("invalid snapshot");
+        return snapshot.to_json();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+// Checks that parsing allocates nothing per value for literals (true,
+// false, null), integers, floats and object members with short keys
+// (ones that fit std::string's inline buffer): a document of 3000 of
+// them costs the same number of heap allocations as one of 3, with
+// parse() and with parse_insitu(). Build and run from the repository
+// root:
+//
+//     g++ -I. tests/alloc_check.cpp -o alloc_check -lpthread && ./alloc_check
+
+#include <string>
+#include <vector>
+#include <map>
+#include <exception>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include "Json.h"
+
+static long g_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) {
+    free(p);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void* p, std::size_t) {
+    free(p);
+}
+#endif
+
+static std::string literal_array(int count) {
+    static const char* const literals[] = { "true", "false", "null" };
+    std::string text = "[";
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) text += ',';
+        text += literals[i % 3];
+    }
+    text += ']';
+    return text;
+}
+
+static std::string number_array(int count, const char* format) {
+    std::string text = "[";
+    for (int i = 0; i < count; ++i) {
+        char number[32];
+        sprintf(number, format, i);
+        if (i > 0) text += ',';
+        text += number;
+    }
+    text += ']';
+    return text;
+}
+
+static std::string integer_array(int count) {
+    return number_array(count, "%d");
+}
+
+static std::string float_array(int count) {
+    return number_array(count, "%d.25e-3");
+}
+
+static std::string keyed_object(int count) {
+    std::string text = "{";
+    for (int i = 0; i < count; ++i) {
+        char member[32];
+        sprintf(member, "\"k%d\":%d", i, i);
+        if (i > 0) text += ',';
+        text += member;
+    }
+    text += '}';
+    return text;
+}
+
+static long parse_allocations(const std::string& text) {
+    long before = g_allocations;
+    {
+        tinyjson::json value = tinyjson::json::parse(text);
+    }
+    return g_allocations - before;
+}
+
+static long insitu_allocations(const std::string& text) {
+    std::vector<char> buffer(text.begin(), text.end());
+    long before = g_allocations;
+    {
+        tinyjson::json value = tinyjson::json::parse_insitu(&buffer[0], buffer.size());
+    }
+    return g_allocations - before;
+}
+
+struct alloc_case {
+    const char* name;
+    std::string (*make)(int count);
+};
+
+struct alloc_parser {
+    const char* name;
+    long (*allocations)(const std::string& text);
+};
+
+int main() {
+    static const alloc_case cases[] = {
+        { "literals", literal_array },
+        { "integers", integer_array },
+        { "floats", float_array },
+        { "object members", keyed_object }
+    };
+
+    static const alloc_parser parsers[] = {
+        { "parse", parse_allocations },
+        { "parse_insitu", insitu_allocations }
+    };
+
+    bool failed = false;
+    for (size_t p = 0; p < sizeof(parsers) / sizeof(parsers[0]); ++p) {
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+            long small_count = parsers[p].allocations(cases[i].make(3));
+            long large_count = parsers[p].allocations(cases[i].make(3000));
+
+            printf("%-12s %-15s 3: %ld allocations, 3000: %ld allocations\n",
+                parsers[p].name, cases[i].name, small_count, large_count);
+
+            if (large_count != small_count) {
+                printf("FAILED: %s allocate per value in %s\n", cases[i].name, parsers[p].name);
+                failed = true;
+            }
+        }
+    }
+    if (failed) return 1;
+    printf("OK\n");
+    return 0;
+}